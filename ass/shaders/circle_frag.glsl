@@ -2,16 +2,25 @@
 
 in vec4 Color;
 in vec2 UV;
+flat in uint ObjectID;
 
 uniform float Radius;
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out uint FragObjectID;
 
 void main() {
     vec2 P = 2.0f*UV - vec2(1.0f);
-    if (sqrt(dot(P, P)) > Radius) {
+    float Distance = length(P);
+
+    // Fade over one pixel's worth of distance so the edge is smooth
+    // without relying on MSAA
+    float EdgeWidth = fwidth(Distance);
+    float Coverage = 1.0f - smoothstep(Radius - EdgeWidth, Radius, Distance);
+    if (Coverage <= 0.0f) {
         discard;
     }
-    FragColor = Color;
+    FragColor = vec4(Color.rgb, Color.a*Coverage);
+    FragObjectID = ObjectID;
 }
 
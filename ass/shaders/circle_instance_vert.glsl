@@ -0,0 +1,26 @@
+#version 420 core
+
+layout(location = 0) in vec4 _Color;
+layout(location = 1) in vec3 _Position;
+layout(location = 2) in float _Radius;
+layout(location = 3) in uint _ObjectID;
+
+uniform mat4 Transform;
+
+out vec4 Color;
+out vec2 P;
+flat out uint ObjectID;
+
+void main() {
+    // Octagon around the circle, drawn as an 8 vertex fan. Corners sit at
+    // 1/cos(pi/8) so the edges touch the circle, covering about 5% more
+    // than the circle instead of the quad's 27%.
+    const float Pi = 3.14159265f;
+    const float CornerScale = 1.0823922f;
+    float Angle = (float(gl_VertexID) + 0.5f)*(Pi/4.0f);
+    P = CornerScale*vec2(cos(Angle), sin(Angle));
+
+    Color = _Color;
+    ObjectID = _ObjectID;
+    gl_Position = Transform*vec4(_Position + vec3(_Radius*P, 0.0f), 1.0);
+}
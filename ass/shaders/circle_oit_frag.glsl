@@ -0,0 +1,22 @@
+#version 330 core
+
+in vec4 Color;
+in vec2 P;
+
+layout(location = 0) out vec4 Accumulation;
+layout(location = 1) out float Revealage;
+
+void main() {
+    float Distance = length(P);
+    float EdgeWidth = fwidth(Distance);
+    float Coverage = 1.0f - smoothstep(1.0f - EdgeWidth, 1.0f, Distance);
+    float Alpha = Color.a*Coverage;
+
+    // Weighted blended OIT (McGuire & Bavoil 2013, eq. 10). Closer and more
+    // opaque fragments weigh more. Zero alpha outside the circle adds
+    // nothing to either target, so no discard is needed.
+    float Weight = clamp(pow(min(1.0f, Alpha*10.0f) + 0.01f, 3.0f)*1e8f*
+                         pow(1.0f - 0.9f*gl_FragCoord.z, 3.0f), 1e-2f, 3e3f);
+    Accumulation = vec4(Color.rgb*Alpha, Alpha)*Weight;
+    Revealage = Alpha;
+}
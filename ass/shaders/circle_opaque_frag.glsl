@@ -0,0 +1,21 @@
+#version 420 core
+
+// Depth is only ever pushed away from the camera, so the driver can keep
+// early depth testing on. A discard would turn it off for every fragment.
+layout(depth_greater) out float gl_FragDepth;
+
+in vec4 Color;
+in vec2 P;
+flat in uint ObjectID;
+
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out uint FragObjectID;
+
+void main() {
+    // Outside the circle the fragment moves to the far plane, where it
+    // fails GL_LESS against the cleared depth and writes nothing.
+    float Inside = step(dot(P, P), 1.0f);
+    gl_FragDepth = mix(1.0f, gl_FragCoord.z, Inside);
+    FragColor = vec4(Color.rgb, 1.0f);
+    FragObjectID = ObjectID;
+}
@@ -0,0 +1,29 @@
+#version 330 core
+
+layout(location = 0) in vec4 _Color;
+layout(location = 1) in vec3 _StartPosition;
+layout(location = 2) in float _SpawnTime;
+layout(location = 3) in vec3 _Velocity;
+layout(location = 4) in float _Radius;
+
+uniform mat4 Transform;
+uniform float Time;
+uniform float Speed;
+uniform int HotIndex;
+
+out vec4 Color;
+out vec2 UV;
+flat out uint ObjectID;
+
+void main() {
+    // Quad corner from the vertex id, drawn as a 4 vertex strip
+    vec2 Corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec3 Center = _StartPosition + Speed*(Time - _SpawnTime)*_Velocity;
+    vec3 Position = Center + vec3(_Radius*(2.0f*Corner - vec2(1.0f)), 0.0f);
+
+    Color = (gl_InstanceID == HotIndex) ? vec4(1.0f) : _Color;
+    UV = Corner;
+    // Records are indexed like the circles, as in CIRCLE_OBJECT_ID
+    ObjectID = uint(gl_InstanceID) + 1u;
+    gl_Position = Transform*vec4(Position, 1.0);
+}
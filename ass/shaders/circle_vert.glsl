@@ -3,14 +3,17 @@
 layout(location = 0) in vec3 _Position;
 layout(location = 1) in vec4 _Color;
 layout(location = 2) in vec2 _UV;
+layout(location = 3) in uint _ObjectID;
 
 uniform mat4 Transform;
 
 out vec4 Color;
 out vec2 UV;
+flat out uint ObjectID;
 
 void main() {
     Color = _Color;
     UV = _UV;
+    ObjectID = _ObjectID;
     gl_Position = Transform*vec4(_Position, 1.0);
 }
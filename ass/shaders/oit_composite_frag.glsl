@@ -0,0 +1,21 @@
+#version 330 core
+
+uniform sampler2D Accumulation;
+uniform sampler2D Revealage;
+
+out vec4 FragColor;
+
+void main() {
+    ivec2 P = ivec2(gl_FragCoord.xy);
+    vec4 Accum = texelFetch(Accumulation, P, 0);
+    float Reveal = texelFetch(Revealage, P, 0).r;
+
+    // Keep the average finite when the half floats saturate
+    if (isinf(max(max(Accum.r, Accum.g), max(Accum.b, Accum.a)))) {
+        Accum.rgb = vec3(Accum.a);
+    }
+    vec3 Average = Accum.rgb/max(Accum.a, 1e-5f);
+
+    // Blended over the scene with SRC_ALPHA, ONE_MINUS_SRC_ALPHA
+    FragColor = vec4(Average, 1.0f - Reveal);
+}
@@ -0,0 +1,23 @@
+#version 400 core
+
+uniform sampler2DMS Accumulation;
+uniform sampler2DMS Revealage;
+
+out vec4 FragColor;
+
+void main() {
+    // Reading gl_SampleID runs this once per sample, so every sample of
+    // the scene gets composited with its own accumulation.
+    ivec2 P = ivec2(gl_FragCoord.xy);
+    vec4 Accum = texelFetch(Accumulation, P, gl_SampleID);
+    float Reveal = texelFetch(Revealage, P, gl_SampleID).r;
+
+    // Keep the average finite when the half floats saturate
+    if (isinf(max(max(Accum.r, Accum.g), max(Accum.b, Accum.a)))) {
+        Accum.rgb = vec3(Accum.a);
+    }
+    vec3 Average = Accum.rgb/max(Accum.a, 1e-5f);
+
+    // Blended over the scene with SRC_ALPHA, ONE_MINUS_SRC_ALPHA
+    FragColor = vec4(Average, 1.0f - Reveal);
+}
@@ -3,9 +3,10 @@
 in vec2 UV;
 
 uniform sampler2D Tex;
+uniform vec2 UVScale;
 
 out vec4 FragColor;
 
 void main() {
-    FragColor = texture(Tex, UV);
+    FragColor = texture(Tex, UV*UVScale);
 }
@@ -1,10 +1,13 @@
 #version 330 core
 
 in vec4 Color;
+flat in uint ObjectID;
 
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out uint FragObjectID;
 
 void main() {
     FragColor = Color;
+    FragObjectID = ObjectID;
 }
 
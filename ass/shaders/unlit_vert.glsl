@@ -2,12 +2,15 @@
 
 layout(location = 0) in vec3 _Position;
 layout(location = 1) in vec4 _Color;
+layout(location = 2) in uint _ObjectID;
 
 uniform mat4 Transform;
 
 out vec4 Color;
+flat out uint ObjectID;
 
 void main() {
     Color = _Color;
+    ObjectID = _ObjectID;
     gl_Position = Transform*vec4(_Position, 1.0);
 }
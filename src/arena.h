@@ -14,7 +14,7 @@ static inline memory_arena CreateArena(void *Base, size_t Cap) {
 }
 
 #define PushSize(Arena, Size) _PushArena(Arena, Size)
-#define PushArray(Arena, Type, Count) (Type *)_PushArena(Arena, sizeof(Type)*Count)
+#define PushArray(Arena, Type, Count) (Type *)_PushArena(Arena, sizeof(Type)*(Count))
 #define PushStruct(Arena, Type) (Type *)_PushArena(Arena, sizeof(Type))
 static inline void *_PushArena(memory_arena *Arena, size_t Size) {
     void *Result = NULL;
@@ -30,4 +30,21 @@ static inline size_t GetRemainingSize(memory_arena *Arena) {
     return Arena->Cap - Arena->Used;
 }
 
-// TODO: temporary arenas
+// Everything pushed between Begin and End is released by End. Nest
+// them like a stack.
+struct temporary_memory {
+    memory_arena *Arena;
+    size_t Used;
+};
+
+static inline temporary_memory BeginTemporaryMemory(memory_arena *Arena) {
+    temporary_memory Result = {};
+    Result.Arena = Arena;
+    Result.Used = Arena->Used;
+    return Result;
+}
+
+static inline void EndTemporaryMemory(temporary_memory Temp) {
+    Assert(Temp.Arena->Used >= Temp.Used);
+    Temp.Arena->Used = Temp.Used;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Cooked meshes, laid out so the pack can be mapped and used as is.
+// Offsets are from the start of the file, so nothing needs patching
+// wherever it ends up mapped, and every blob starts on
+// ASSET_PACK_ALIGNMENT. Entries are sorted by NameHash.
+#define ASSET_PACK_MAGIC 0x4B434150 // "PACK"
+#define ASSET_PACK_VERSION 3
+#define ASSET_PACK_ALIGNMENT 64
+
+struct asset_pack_header {
+    u32 Magic;
+    u32 Version;
+    // Packs cooked with a different vertex layout are rejected
+    u32 VertexSize;
+    u32 EntryCount;
+    u64 EntriesOffset;
+};
+
+struct asset_pack_entry {
+    u64 NameHash;
+    u64 VertexOffset;
+    u64 IndexOffset;
+    u32 VertexCount;
+    u32 IndexCount;
+    // Bump the version if MAX_MESH_PART_COUNT or MAX_MESH_LOD_COUNT change
+    u32 PartCount;
+    u32 LODCount;
+    mesh_part Parts[MAX_MESH_PART_COUNT];
+    mesh_lod LODs[MAX_MESH_LOD_COUNT];
+};
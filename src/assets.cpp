@@ -0,0 +1,708 @@
+#pragma once
+
+// Out of range LODs fall back to the coarsest one
+static inline mesh_lod *GetMeshLOD(mesh_object *Mesh, u32 LOD) {
+    Assert(Mesh->LODCount > 0);
+    if (LOD >= Mesh->LODCount) {
+        LOD = Mesh->LODCount - 1;
+    }
+    return Mesh->LODs + LOD;
+}
+
+// The whole mesh as one part and one LOD
+static inline void InitSinglePartMesh(mesh_object *Mesh) {
+    Assert(Mesh->VertexCount <= MAX_MESH_PART_VERTEX_COUNT);
+    Mesh->PartCount = 1;
+    Mesh->Parts[0].BaseVertex = 0;
+    Mesh->Parts[0].VertexCount = Mesh->VertexCount;
+    Mesh->Parts[0].FirstIndex = 0;
+    Mesh->Parts[0].IndexCount = Mesh->IndexCount;
+    Mesh->LODCount = 1;
+    Mesh->LODs[0].FirstPart = 0;
+    Mesh->LODs[0].PartCount = 1;
+}
+
+// Planes too big for one part are split into bands of rows. Neighbouring
+// bands share the row on their seam instead of duplicating it.
+static void CreatePlane(assets *Assets, random_series *Series, mesh_object *Mesh, vec3 CenterP, f32 Width, f32 Height, u32 VertexCount, vec4 Color = vec4(1.0f)) {
+    u32 QuadCount = (VertexCount - 1)*(VertexCount - 1);
+    u32 IndexCount = 6*QuadCount;
+    u32 TotalVertexCount = VertexCount*VertexCount;
+    u32 RowsPerPart = MAX_MESH_PART_VERTEX_COUNT/VertexCount;
+    u32 PartCount = (RowsPerPart < 2) ? 0 : (VertexCount - 1 + RowsPerPart - 2)/(RowsPerPart - 1);
+    if (PartCount == 0 || PartCount > MAX_MESH_PART_COUNT) {
+        LWARN("Failed to create plane. %ux%u vertices needs more than %u parts.", VertexCount, VertexCount, MAX_MESH_PART_COUNT);
+        return;
+    }
+
+    vertex *Vertices = PushArray(&Assets->VertexArena, vertex, TotalVertexCount);
+    u16 *Indices = PushArray(&Assets->IndexArena, u16, IndexCount);
+
+    if (Vertices && Indices) {
+        Mesh->VertexCount = TotalVertexCount;
+        Mesh->IndexCount = IndexCount;
+        Mesh->Vertices = Vertices;
+        Mesh->Indices = Indices;
+
+        f32 SpacingX = (f32)Width/VertexCount;
+        f32 SpacingY = (f32)Height/VertexCount;
+        for (u32 j = 0; j < VertexCount; ++j) {
+            for (u32 i = 0; i < VertexCount; ++i) {
+                u32 Index = j*VertexCount + i;
+                Vertices[Index].Position = CenterP + vec3(vec2((f32)i*SpacingX, (f32)j*SpacingY), 0.f) - vec3(0.5f*vec2(Width - SpacingX, Height - SpacingY), 0.f);
+                Vertices[Index].Position.z += 0.15f*RandomBilateral(Series);
+                Vertices[Index].Color = Color;
+            }
+        }
+
+        Mesh->PartCount = PartCount;
+        u32 QuadCounter = 0;
+        for (u32 PartIndex = 0; PartIndex < PartCount; ++PartIndex) {
+            u32 FirstRow = PartIndex*(RowsPerPart - 1);
+            u32 QuadRowCount = VertexCount - 1 - FirstRow;
+            if (QuadRowCount > RowsPerPart - 1) {
+                QuadRowCount = RowsPerPart - 1;
+            }
+
+            mesh_part *Part = Mesh->Parts + PartIndex;
+            Part->BaseVertex = FirstRow*VertexCount;
+            Part->VertexCount = (QuadRowCount + 1)*VertexCount;
+            Part->FirstIndex = QuadCounter*6;
+            Part->IndexCount = QuadRowCount*(VertexCount - 1)*6;
+            for (u32 j = 0; j < QuadRowCount; ++j) {
+                for (u32 i = 0; i < VertexCount - 1; ++i) {
+                    Assert(QuadCounter < QuadCount);
+                    u32 Corner = j*VertexCount + i;
+                    Indices[QuadCounter*6 + 0] = (u16)(Corner + 0);
+                    Indices[QuadCounter*6 + 1] = (u16)(Corner + 1);
+                    Indices[QuadCounter*6 + 2] = (u16)(Corner + 1 + VertexCount);
+                    Indices[QuadCounter*6 + 3] = (u16)(Corner + 1 + VertexCount);
+                    Indices[QuadCounter*6 + 4] = (u16)(Corner + VertexCount);
+                    Indices[QuadCounter*6 + 5] = (u16)(Corner + 0);
+                    ++QuadCounter;
+                }
+            }
+        }
+        Mesh->LODCount = 1;
+        Mesh->LODs[0].FirstPart = 0;
+        Mesh->LODs[0].PartCount = PartCount;
+    }
+    else {
+        u32 RemainingVertexCount = GetRemainingSize(&Assets->VertexArena)/sizeof(vertex);
+        u32 RemainingIndexCount = GetRemainingSize(&Assets->IndexArena)/sizeof(u16);
+        LWARN("Failed to create plane. Required %zu vertices and %zu indices, but there was only space for %zu and %zu", TotalVertexCount, IndexCount, RemainingVertexCount, RemainingIndexCount);
+        return;
+    }
+
+    OptimizeMesh(&Assets->ScratchArena, Mesh, "plane");
+    GenerateMeshLODs(&Assets->IndexArena, &Assets->ScratchArena, Mesh, "plane");
+}
+
+//
+// Mesh registry
+//
+// Cells are found by linear probing from the folded name hash. Names are
+// only kept as hashes, two names colliding in all 64 bits is treated as
+// the same mesh. Released cells are refilled by shifting later entries
+// of the probe run back, so there are no tombstones and lookups never
+// degrade.
+//
+static inline void LockMeshRegistry(mesh_registry *Registry) {
+    while (PlatformAtomicExchange(&Registry->Lock, 1)) {
+    }
+}
+
+static inline void UnlockMeshRegistry(mesh_registry *Registry) {
+    PlatformAtomicExchange(&Registry->Lock, 0);
+}
+
+static inline u32 GetMeshRegistryHome(u64 NameHash) {
+    u32 Result = (u32)(NameHash ^ (NameHash >> 32)) & (MESH_REGISTRY_CELL_COUNT - 1);
+    return Result;
+}
+
+static void InitMeshRegistry(mesh_registry *Registry, memory_arena *Arena) {
+    Registry->Cells = PushArray(Arena, mesh_registry_cell, MESH_REGISTRY_CELL_COUNT);
+    Registry->NameHashes = PushArray(Arena, u64, MAX_MESH_COUNT);
+    Registry->Generations = PushArray(Arena, u32, MAX_MESH_COUNT);
+    Registry->FreeSlots = PushArray(Arena, u32, MAX_MESH_COUNT);
+    Assert(Registry->Cells && Registry->NameHashes && Registry->Generations && Registry->FreeSlots);
+    for (u32 i = 0; i < MESH_REGISTRY_CELL_COUNT; ++i) {
+        Registry->Cells[i].Slot = MESH_SLOT_NONE;
+    }
+    Registry->FreeSlotCount = 0;
+    Registry->SlotCount = 0;
+    Registry->Lock = 0;
+}
+
+// Returns the cell holding NameHash, or the empty cell ending its probe run
+static mesh_registry_cell *FindMeshRegistryCell(mesh_registry *Registry, u64 NameHash) {
+    u32 Mask = MESH_REGISTRY_CELL_COUNT - 1;
+    u32 CellIndex = GetMeshRegistryHome(NameHash);
+    for (;;) {
+        mesh_registry_cell *Cell = Registry->Cells + CellIndex;
+        if (Cell->Slot == MESH_SLOT_NONE || Cell->NameHash == NameHash) {
+            return Cell;
+        }
+        CellIndex = (CellIndex + 1) & Mask;
+    }
+}
+
+static inline mesh_handle GetMeshHandle(mesh_registry *Registry, u32 Slot) {
+    mesh_handle Result = {Slot, Registry->Generations[Slot]};
+    return Result;
+}
+
+// Returns an invalid handle if nothing is registered under Name
+static mesh_handle FindMesh(assets *Assets, const char *Name) {
+    mesh_registry *Registry = &Assets->Registry;
+    mesh_handle Result = {MESH_SLOT_NONE, 0};
+    LockMeshRegistry(Registry);
+    mesh_registry_cell *Cell = FindMeshRegistryCell(Registry, HashString(Name));
+    if (Cell->Slot != MESH_SLOT_NONE) {
+        Result = GetMeshHandle(Registry, Cell->Slot);
+    }
+    UnlockMeshRegistry(Registry);
+    return Result;
+}
+
+// Gives Name a zeroed mesh and BVH. Returns an invalid handle if the name
+// is taken or every slot is in use.
+static mesh_handle RegisterMesh(assets *Assets, const char *Name) {
+    mesh_registry *Registry = &Assets->Registry;
+    mesh_handle Result = {MESH_SLOT_NONE, 0};
+    u64 NameHash = HashString(Name);
+    LockMeshRegistry(Registry);
+    mesh_registry_cell *Cell = FindMeshRegistryCell(Registry, NameHash);
+    if (Cell->Slot != MESH_SLOT_NONE) {
+        UnlockMeshRegistry(Registry);
+        LWARN("Mesh %s is already registered.", Name);
+        return Result;
+    }
+
+    u32 Slot;
+    if (Registry->FreeSlotCount) {
+        Slot = Registry->FreeSlots[--Registry->FreeSlotCount];
+    }
+    else if (Registry->SlotCount < MAX_MESH_COUNT) {
+        Slot = Registry->SlotCount++;
+        Registry->Generations[Slot] = 1;
+    }
+    else {
+        UnlockMeshRegistry(Registry);
+        LWARN("Out of mesh slots, %s not registered.", Name);
+        return Result;
+    }
+
+    Cell->NameHash = NameHash;
+    Cell->Slot = Slot;
+    Registry->NameHashes[Slot] = NameHash;
+    Assets->Meshes[Slot] = {};
+    Assets->BVHs[Slot] = {};
+    Result = GetMeshHandle(Registry, Slot);
+    UnlockMeshRegistry(Registry);
+    return Result;
+}
+
+// Returns 0 for invalid or released handles
+static inline mesh_object *GetMesh(assets *Assets, mesh_handle Handle) {
+    if (Handle.Slot >= Assets->Registry.SlotCount ||
+            Assets->Registry.Generations[Handle.Slot] != Handle.Generation) {
+        return 0;
+    }
+    return Assets->Meshes + Handle.Slot;
+}
+
+// The slot's vertex, index and BVH storage stays with the arenas, only
+// the slot and its name are handed back. The caller makes sure the
+// renderer is done with it.
+static void ReleaseMesh(assets *Assets, mesh_handle Handle) {
+    mesh_registry *Registry = &Assets->Registry;
+    LockMeshRegistry(Registry);
+    if (!GetMesh(Assets, Handle)) {
+        UnlockMeshRegistry(Registry);
+        return;
+    }
+
+    u32 Mask = MESH_REGISTRY_CELL_COUNT - 1;
+    mesh_registry_cell *Cell = FindMeshRegistryCell(Registry, Registry->NameHashes[Handle.Slot]);
+    Assert(Cell->Slot == Handle.Slot);
+    u32 Hole = (u32)(Cell - Registry->Cells);
+    u32 Next = (Hole + 1) & Mask;
+    while (Registry->Cells[Next].Slot != MESH_SLOT_NONE) {
+        // An entry may fill the hole unless its home lies between the
+        // hole and where it sits now
+        u32 Home = GetMeshRegistryHome(Registry->Cells[Next].NameHash);
+        if (((Next - Home) & Mask) >= ((Next - Hole) & Mask)) {
+            Registry->Cells[Hole] = Registry->Cells[Next];
+            Hole = Next;
+        }
+        Next = (Next + 1) & Mask;
+    }
+    Registry->Cells[Hole].Slot = MESH_SLOT_NONE;
+
+    ++Registry->Generations[Handle.Slot];
+    Registry->FreeSlots[Registry->FreeSlotCount++] = Handle.Slot;
+    UnlockMeshRegistry(Registry);
+}
+
+static inline void InitAssetStore(assets *Assets, memory_arena *Arena) {
+    size_t VertexStoreSize = 12*MiB;
+    void *VertexBase = PushSize(Arena, VertexStoreSize);
+    Assert(VertexBase);
+    Assets->VertexArena = CreateArena(VertexBase, VertexStoreSize);
+
+    size_t IndexStoreSize = 12*MiB;
+    void *IndexBase = PushSize(Arena, IndexStoreSize);
+    Assert(IndexBase);
+    Assets->IndexArena = CreateArena(IndexBase, IndexStoreSize);
+
+    size_t BVHStoreSize = 16*MiB;
+    void *BVHBase = PushSize(Arena, BVHStoreSize);
+    Assert(BVHBase);
+    Assets->BVHArena = CreateArena(BVHBase, BVHStoreSize);
+
+    size_t ScratchSize = 16*MiB;
+    void *ScratchBase = PushSize(Arena, ScratchSize);
+    Assert(ScratchBase);
+    Assets->ScratchArena = CreateArena(ScratchBase, ScratchSize);
+
+    Assets->Meshes = PushArray(Arena, mesh_object, MAX_MESH_COUNT);
+    Assets->BVHs = PushArray(Arena, mesh_bvh, MAX_MESH_COUNT);
+    Assert(Assets->Meshes && Assets->BVHs);
+    InitMeshRegistry(&Assets->Registry, Arena);
+}
+
+//
+// glTF models
+//
+// Files are memory mapped through cgltf's file callbacks, so a .glb or a
+// .gltf and its .bin buffers are never read into a copy. Vertex data that
+// is already interleaved exactly like `vertex` and u16 indices are used
+// in place, everything else is converted into the asset arenas.
+// Positions are used as authored. Only fully converted meshes go through
+// the mesh optimizer and get LODs, data used in place is drawn in file
+// order at full detail, so the cooker loads with ForceCopy to optimize
+// everything.
+//
+static cgltf_result MapModelFile(const cgltf_memory_options *MemoryOptions, const cgltf_file_options *FileOptions,
+        const char *Path, cgltf_size *Size, void **Data) {
+    // LoadModel reports the failure
+    entire_file File = PlatformMapFile(Path, false);
+    if (!File.Contents) {
+        return cgltf_result_file_not_found;
+    }
+    *Size = File.Size;
+    *Data = File.Contents;
+    return cgltf_result_success;
+}
+
+static void UnmapModelFile(const cgltf_memory_options *MemoryOptions, const cgltf_file_options *FileOptions, void *Data) {
+    PlatformUnmapFile(Data);
+}
+
+static inline b32 IsFloatAccessor(cgltf_accessor *Accessor, cgltf_type Type) {
+    b32 Result = (Accessor && !Accessor->is_sparse && Accessor->buffer_view &&
+            Accessor->component_type == cgltf_component_type_r_32f && Accessor->type == Type);
+    return Result;
+}
+
+// Matches when the three attributes interleave in one view with the
+// same offsets and stride as `vertex`
+static vertex *GetInPlaceVertices(cgltf_accessor *Positions, cgltf_accessor *Colors, cgltf_accessor *UVs) {
+    if (!IsFloatAccessor(Positions, cgltf_type_vec3) ||
+            !IsFloatAccessor(Colors, cgltf_type_vec4) ||
+            !IsFloatAccessor(UVs, cgltf_type_vec2)) {
+        return 0;
+    }
+
+    cgltf_buffer_view *View = Colors->buffer_view;
+    if (Positions->buffer_view != View || UVs->buffer_view != View ||
+            Colors->stride != sizeof(vertex) || Positions->stride != sizeof(vertex) || UVs->stride != sizeof(vertex) ||
+            Positions->count != Colors->count || UVs->count != Colors->count ||
+            Positions->offset != Colors->offset + offsetof(vertex, Position) ||
+            UVs->offset != Colors->offset + offsetof(vertex, UV)) {
+        return 0;
+    }
+
+    vertex *Result = (vertex *)(cgltf_buffer_view_data(View) + Colors->offset);
+    return Result;
+}
+
+static u16 *GetInPlaceIndices(cgltf_accessor *Indices) {
+    u16 *Result = 0;
+    if (!Indices->is_sparse && Indices->buffer_view &&
+            Indices->component_type == cgltf_component_type_r_16u && Indices->stride == sizeof(u16)) {
+        Result = (u16 *)(cgltf_buffer_view_data(Indices->buffer_view) + Indices->offset);
+    }
+    return Result;
+}
+
+static inline void ReadModelVertex(cgltf_accessor *Positions, cgltf_accessor *Colors, cgltf_accessor *UVs, u32 Index, vertex *Vertex) {
+    Vertex->Position = vec3();
+    Vertex->Color = vec4(1.f, 1.f, 1.f, 1.f);
+    Vertex->UV = vec2();
+    cgltf_accessor_read_float(Positions, Index, &Vertex->Position.x, 3);
+    if (Colors) {
+        // vec3 colors leave alpha at one
+        cgltf_accessor_read_float(Colors, Index, &Vertex->Color.x, (Colors->type == cgltf_type_vec3) ? 3 : 4);
+    }
+    if (UVs) {
+        cgltf_accessor_read_float(UVs, Index, &Vertex->UV.x, 2);
+    }
+}
+
+// Primitives with more vertices than a part can index are cut into parts
+// in triangle order. A part takes triangles until the next one would push
+// it over MAX_MESH_PART_VERTEX_COUNT, and gets its own copy of every
+// vertex it uses, so vertices on a cut are duplicated. The first pass
+// only sizes the parts, the second writes them.
+static b32 LoadSplitModelPrimitive(assets *Assets, loaded_model *Model, cgltf_primitive *Primitive,
+        cgltf_accessor *Positions, cgltf_accessor *Colors, cgltf_accessor *UVs, mesh_object *Mesh, const char *Name) {
+    u32 SourceVertexCount = (u32)Positions->count;
+    u32 IndexCount = Primitive->indices ? (u32)Primitive->indices->count : SourceVertexCount;
+    IndexCount -= IndexCount % 3;
+
+    memory_arena *Scratch = &Assets->ScratchArena;
+    temporary_memory Temp = BeginTemporaryMemory(Scratch);
+    u32 *SourceIndices = PushArray(Scratch, u32, IndexCount);
+    // Part number plus one that last used each source vertex, and where
+    // it landed in that part
+    u32 *Stamps = PushArray(Scratch, u32, SourceVertexCount);
+    u32 *Remap = PushArray(Scratch, u32, SourceVertexCount);
+    if (!SourceIndices || !Stamps || !Remap) {
+        LWARN("Scratch arena full, skipped %s with %u vertices.", Name, SourceVertexCount);
+        EndTemporaryMemory(Temp);
+        return false;
+    }
+    for (u32 i = 0; i < IndexCount; ++i) {
+        SourceIndices[i] = Primitive->indices ? (u32)cgltf_accessor_read_index(Primitive->indices, i) : i;
+    }
+
+    vertex *Vertices = 0;
+    u16 *Indices = 0;
+    u32 VertexCount = 0;
+    for (u32 Pass = 0; Pass < 2; ++Pass) {
+        memset(Stamps, 0, SourceVertexCount*sizeof(u32));
+        Mesh->PartCount = 0;
+        VertexCount = 0;
+        mesh_part *Part = 0;
+        for (u32 i = 0; i < IndexCount; i += 3) {
+            u32 NewVertexCount = 0;
+            for (u32 k = 0; k < 3; ++k) {
+                if (Part == 0 || Stamps[SourceIndices[i + k]] != Mesh->PartCount) {
+                    ++NewVertexCount;
+                }
+            }
+            if (Part == 0 || Part->VertexCount + NewVertexCount > MAX_MESH_PART_VERTEX_COUNT) {
+                if (Mesh->PartCount == MAX_MESH_PART_COUNT) {
+                    LWARN("Skipped %s, %u vertices needs more than %u parts.", Name, SourceVertexCount, MAX_MESH_PART_COUNT);
+                    EndTemporaryMemory(Temp);
+                    return false;
+                }
+                Part = Mesh->Parts + Mesh->PartCount++;
+                Part->BaseVertex = VertexCount;
+                Part->VertexCount = 0;
+                Part->FirstIndex = i;
+                Part->IndexCount = 0;
+            }
+
+            for (u32 k = 0; k < 3; ++k) {
+                u32 Source = SourceIndices[i + k];
+                if (Stamps[Source] != Mesh->PartCount) {
+                    Stamps[Source] = Mesh->PartCount;
+                    Remap[Source] = Part->VertexCount++;
+                    if (Vertices) {
+                        ReadModelVertex(Positions, Colors, UVs, Source, Vertices + VertexCount);
+                    }
+                    ++VertexCount;
+                }
+                if (Indices) {
+                    Indices[i + k] = (u16)Remap[Source];
+                }
+            }
+            Part->IndexCount += 3;
+        }
+
+        if (Pass == 0) {
+            Vertices = PushArray(&Assets->VertexArena, vertex, VertexCount);
+            Indices = PushArray(&Assets->IndexArena, u16, IndexCount);
+            if (!Vertices || !Indices) {
+                LWARN("Asset arenas full, skipped %s with %u vertices.", Name, VertexCount);
+                EndTemporaryMemory(Temp);
+                return false;
+            }
+        }
+    }
+    EndTemporaryMemory(Temp);
+
+    Mesh->Vertices = Vertices;
+    Mesh->VertexCount = VertexCount;
+    Mesh->Indices = Indices;
+    Mesh->IndexCount = IndexCount;
+    Mesh->LODCount = 1;
+    Mesh->LODs[0].FirstPart = 0;
+    Mesh->LODs[0].PartCount = Mesh->PartCount;
+    Model->BytesCopied += VertexCount*sizeof(vertex) + IndexCount*sizeof(u16);
+    LINFO("Split %s: %u vertices into %u parts, %u after duplicating the cuts.", Name, SourceVertexCount, Mesh->PartCount, VertexCount);
+
+    OptimizeMesh(Scratch, Mesh, Name);
+    return true;
+}
+
+static b32 LoadModelPrimitive(assets *Assets, loaded_model *Model, cgltf_primitive *Primitive, mesh_object *Mesh, b32 ForceCopy, const char *Name) {
+    cgltf_accessor *Positions = 0;
+    cgltf_accessor *Colors = 0;
+    cgltf_accessor *UVs = 0;
+    for (cgltf_size i = 0; i < Primitive->attributes_count; ++i) {
+        cgltf_attribute *Attribute = Primitive->attributes + i;
+        if (Attribute->index != 0) {
+            continue;
+        }
+        switch (Attribute->type) {
+            case cgltf_attribute_type_position: Positions = Attribute->data; break;
+            case cgltf_attribute_type_color: Colors = Attribute->data; break;
+            case cgltf_attribute_type_texcoord: UVs = Attribute->data; break;
+            default: break;
+        }
+    }
+    if (Primitive->type != cgltf_primitive_type_triangles || !Positions) {
+        return false;
+    }
+
+    u32 VertexCount = (u32)Positions->count;
+    u32 IndexCount = Primitive->indices ? (u32)Primitive->indices->count : VertexCount;
+    if (VertexCount > MAX_MESH_PART_VERTEX_COUNT) {
+        return LoadSplitModelPrimitive(Assets, Model, Primitive, Positions, Colors, UVs, Mesh, Name);
+    }
+
+    vertex *Vertices = ForceCopy ? 0 : GetInPlaceVertices(Positions, Colors, UVs);
+    b32 Writable = !Vertices;
+    if (Vertices) {
+        Model->BytesReferenced += VertexCount*sizeof(vertex);
+    }
+    else {
+        Vertices = PushArray(&Assets->VertexArena, vertex, VertexCount);
+        if (!Vertices) {
+            LWARN("Vertex arena full, skipped a primitive with %u vertices.", VertexCount);
+            return false;
+        }
+        for (u32 i = 0; i < VertexCount; ++i) {
+            ReadModelVertex(Positions, Colors, UVs, i, Vertices + i);
+        }
+        Model->BytesCopied += VertexCount*sizeof(vertex);
+    }
+
+    u16 *Indices = (Primitive->indices && !ForceCopy) ? GetInPlaceIndices(Primitive->indices) : 0;
+    Writable = Writable && !Indices;
+    if (Indices) {
+        Model->BytesReferenced += IndexCount*sizeof(u16);
+    }
+    else {
+        Indices = PushArray(&Assets->IndexArena, u16, IndexCount);
+        if (!Indices) {
+            LWARN("Index arena full, skipped a primitive with %u indices.", IndexCount);
+            return false;
+        }
+        for (u32 i = 0; i < IndexCount; ++i) {
+            Indices[i] = (u16)(Primitive->indices ? cgltf_accessor_read_index(Primitive->indices, i) : i);
+        }
+        Model->BytesCopied += IndexCount*sizeof(u16);
+    }
+
+    Mesh->Vertices = Vertices;
+    Mesh->VertexCount = VertexCount;
+    Mesh->Indices = Indices;
+    Mesh->IndexCount = IndexCount;
+    InitSinglePartMesh(Mesh);
+    if (Writable) {
+        OptimizeMesh(&Assets->ScratchArena, Mesh, Name);
+        GenerateMeshLODs(&Assets->IndexArena, &Assets->ScratchArena, Mesh, Name);
+    }
+    return true;
+}
+
+// Copies the file name without its directory and extension
+static void GetFileStem(char *Path, char *Stem, size_t StemSize) {
+    char *Begin = Path;
+    for (char *At = Path; *At; ++At) {
+        if (*At == '/' || *At == '\\') {
+            Begin = At + 1;
+        }
+    }
+    char *End = strrchr(Begin, '.');
+    size_t Length = End ? (size_t)(End - Begin) : strlen(Begin);
+    if (Length >= StemSize) {
+        Length = StemSize - 1;
+    }
+    memcpy(Stem, Begin, Length);
+    Stem[Length] = '\0';
+}
+
+// Returns the model, or 0 if the file is missing or invalid. Every
+// triangle primitive becomes one mesh registered as "<file stem>/<n>",
+// with handles in Assets->ModelMeshes starting at Model->FirstMesh.
+static loaded_model *LoadModel(assets *Assets, char *Path, b32 MissingIsError = true, b32 ForceCopy = false) {
+    if (Assets->ModelCount >= ArrayCount(Assets->Models)) {
+        LWARN("Too many models, %s not loaded.", Path);
+        return 0;
+    }
+
+    f64 BeginSeconds = PlatformGetSeconds();
+    cgltf_options Options = {};
+    Options.file.read = MapModelFile;
+    Options.file.release = UnmapModelFile;
+
+    cgltf_data *Data = 0;
+    cgltf_result Result = cgltf_parse_file(&Options, Path, &Data);
+    if (Result == cgltf_result_success) {
+        Result = cgltf_load_buffers(&Options, Data, Path);
+    }
+    if (Result == cgltf_result_success) {
+        Result = cgltf_validate(Data);
+    }
+    if (Result != cgltf_result_success) {
+        if (Result != cgltf_result_file_not_found || MissingIsError) {
+            LERROR("Failed to load model %s (cgltf result %d).", Path, Result);
+        }
+        cgltf_free(Data);
+        return 0;
+    }
+
+    loaded_model *Model = Assets->Models + Assets->ModelCount++;
+    *Model = {};
+    Model->Data = Data;
+    Model->FirstMesh = Assets->ModelMeshCount;
+    char Stem[128];
+    GetFileStem(Path, Stem, sizeof(Stem));
+    for (cgltf_size MeshIndex = 0; MeshIndex < Data->meshes_count; ++MeshIndex) {
+        cgltf_mesh *SourceMesh = Data->meshes + MeshIndex;
+        for (cgltf_size PrimitiveIndex = 0; PrimitiveIndex < SourceMesh->primitives_count; ++PrimitiveIndex) {
+            if (Assets->ModelMeshCount >= MAX_MODEL_MESH_COUNT) {
+                LWARN("Out of model mesh slots, the rest of %s is skipped.", Path);
+                break;
+            }
+            char Name[256];
+            snprintf(Name, sizeof(Name), "%s/%u", Stem, Model->MeshCount);
+            mesh_handle Handle = RegisterMesh(Assets, Name);
+            mesh_object *Mesh = GetMesh(Assets, Handle);
+            if (!Mesh) {
+                continue;
+            }
+            if (LoadModelPrimitive(Assets, Model, SourceMesh->primitives + PrimitiveIndex, Mesh, ForceCopy, Name)) {
+                Assets->ModelMeshes[Assets->ModelMeshCount++] = Handle;
+                ++Model->MeshCount;
+            }
+            else {
+                ReleaseMesh(Assets, Handle);
+            }
+        }
+    }
+
+    LINFO("Loaded model %s: %u meshes in %.2fms, %zu bytes in place, %zu bytes copied.", Path, Model->MeshCount,
+            1000.0*(PlatformGetSeconds() - BeginSeconds), Model->BytesReferenced, Model->BytesCopied);
+    return Model;
+}
+
+//
+// Asset pack
+//
+// Built offline by the cooker. The whole pack is one read-only mapping
+// and meshes point straight into it, so loading does no per-vertex work.
+//
+static inline u64 AlignPackOffset(u64 Offset) {
+    u64 Result = (Offset + ASSET_PACK_ALIGNMENT - 1) & ~(u64)(ASSET_PACK_ALIGNMENT - 1);
+    return Result;
+}
+
+static b32 OpenAssetPack(assets *Assets, char *Path) {
+    entire_file File = PlatformMapFile(Path, false);
+    if (!File.Contents) {
+        return false;
+    }
+
+    asset_pack_header *Header = (asset_pack_header *)File.Contents;
+    b32 Valid = (File.Size >= sizeof(*Header) &&
+            Header->Magic == ASSET_PACK_MAGIC &&
+            Header->Version == ASSET_PACK_VERSION &&
+            Header->VertexSize == sizeof(vertex) &&
+            Header->EntriesOffset + (u64)Header->EntryCount*sizeof(asset_pack_entry) <= File.Size);
+    if (Valid) {
+        asset_pack_entry *Entries = (asset_pack_entry *)(File.Contents + Header->EntriesOffset);
+        for (u32 i = 0; i < Header->EntryCount; ++i) {
+            asset_pack_entry *Entry = Entries + i;
+            if (Entry->VertexOffset + (u64)Entry->VertexCount*sizeof(vertex) > File.Size ||
+                    Entry->IndexOffset + (u64)Entry->IndexCount*sizeof(u16) > File.Size ||
+                    Entry->PartCount == 0 || Entry->PartCount > MAX_MESH_PART_COUNT ||
+                    Entry->LODCount == 0 || Entry->LODCount > MAX_MESH_LOD_COUNT) {
+                Valid = false;
+                break;
+            }
+            for (u32 PartIndex = 0; PartIndex < Entry->PartCount; ++PartIndex) {
+                mesh_part *Part = Entry->Parts + PartIndex;
+                if ((u64)Part->FirstIndex + Part->IndexCount > Entry->IndexCount ||
+                        (u64)Part->BaseVertex + Part->VertexCount > Entry->VertexCount ||
+                        Part->VertexCount > MAX_MESH_PART_VERTEX_COUNT) {
+                    Valid = false;
+                }
+            }
+            for (u32 LOD = 0; LOD < Entry->LODCount; ++LOD) {
+                if ((u64)Entry->LODs[LOD].FirstPart + Entry->LODs[LOD].PartCount > Entry->PartCount) {
+                    Valid = false;
+                }
+            }
+        }
+    }
+    if (!Valid) {
+        LWARN("Asset pack %s is stale or corrupt, building assets at runtime.", Path);
+        PlatformUnmapFile(File.Contents);
+        return false;
+    }
+
+    Assets->Pack = File;
+    LINFO("Mapped asset pack %s, %u meshes in %zu bytes.", Path, Header->EntryCount, File.Size);
+    return true;
+}
+
+// Registers the mesh under Name if the pack has it, returns an invalid
+// handle otherwise
+static mesh_handle LoadPackedMesh(assets *Assets, char *Name) {
+    mesh_handle Result = {MESH_SLOT_NONE, 0};
+    if (!Assets->Pack.Contents) {
+        return Result;
+    }
+
+    asset_pack_header *Header = (asset_pack_header *)Assets->Pack.Contents;
+    asset_pack_entry *Entries = (asset_pack_entry *)(Assets->Pack.Contents + Header->EntriesOffset);
+    u64 NameHash = HashString(Name);
+    u32 First = 0;
+    u32 Last = Header->EntryCount;
+    while (First < Last) {
+        u32 Middle = First + (Last - First)/2;
+        if (Entries[Middle].NameHash < NameHash) {
+            First = Middle + 1;
+        }
+        else {
+            Last = Middle;
+        }
+    }
+    if (First == Header->EntryCount || Entries[First].NameHash != NameHash) {
+        return Result;
+    }
+    Result = RegisterMesh(Assets, Name);
+    mesh_object *Mesh = GetMesh(Assets, Result);
+    if (!Mesh) {
+        return Result;
+    }
+
+    asset_pack_entry *Entry = Entries + First;
+    Mesh->Vertices = (vertex *)(Assets->Pack.Contents + Entry->VertexOffset);
+    Mesh->VertexCount = Entry->VertexCount;
+    Mesh->Indices = (u16 *)(Assets->Pack.Contents + Entry->IndexOffset);
+    Mesh->IndexCount = Entry->IndexCount;
+    Mesh->PartCount = Entry->PartCount;
+    Mesh->LODCount = Entry->LODCount;
+    memcpy(Mesh->Parts, Entry->Parts, sizeof(Mesh->Parts));
+    memcpy(Mesh->LODs, Entry->LODs, sizeof(Mesh->LODs));
+    return Result;
+}
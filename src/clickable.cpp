@@ -95,82 +95,91 @@ static void InitCamera(camera *Camera) {
 #endif
 }
 
-static void CreatePlane(assets  *Assets, mesh_object *Mesh, vec3 CenterP, f32 Width, f32 Height, u32 VertexCount, vec4 Color = vec4(1.0f)) {
-    u32 QuadCount = (VertexCount - 1)*(VertexCount - 1);
-    u32 IndexCount = 6*QuadCount;
-    u32 TotalVertexCount = VertexCount*VertexCount;
-    vertex *Vertices = PushArray(&Assets->VertexArena, vertex, TotalVertexCount);
-    u16 *Indices = PushArray(&Assets->IndexArena, u16, IndexCount);
-
-    if (Vertices && Indices) {
-        Mesh->VertexCount = TotalVertexCount;
-        Mesh->IndexCount = IndexCount;
-        Mesh->Vertices = Vertices;
-        Mesh->Indices = Indices;
-
-        f32 SpacingX = (f32)Width/VertexCount;
-        f32 SpacingY = (f32)Height/VertexCount;
-        for (u32 j = 0; j < VertexCount; ++j) {
-            for (u32 i = 0; i < VertexCount; ++i) {
-                u32 Index = j*VertexCount + i;
-                Vertices[Index].Position = CenterP + vec3(vec2((f32)i*SpacingX, (f32)j*SpacingY), 0.f) - vec3(0.5f*vec2(Width - SpacingX, Height - SpacingY), 0.f);
-                Vertices[Index].Position.z += 0.15f*RandomBilateral(&GlobalRandom);
-                Vertices[Index].Color = Color;
-            }
-        }
+static inline void CreateTestObject(assets *Assets) {
+    mesh_object *Mesh = GetMesh(Assets, RegisterMesh(Assets, "test_object"));
+    Assert(Mesh);
+    CreatePlane(Assets, &GlobalRandom, Mesh, vec3(), 8.f, 6.f, 24);
+}
 
-        u32 QuadCounter = 0;
-        for (u32 i = 0; i < TotalVertexCount - (VertexCount - 1); ++i) {
-            if (i % VertexCount < (VertexCount - 1)) {
-                Assert(QuadCounter <= QuadCount);
-                Indices[QuadCounter*6 + 0] = i + 0;
-                Indices[QuadCounter*6 + 1] = i + 1;
-                Indices[QuadCounter*6 + 2] = i + 1 + VertexCount;
-                Indices[QuadCounter*6 + 3] = i + 1 + VertexCount;
-                Indices[QuadCounter*6 + 4] = i + VertexCount;
-                Indices[QuadCounter*6 + 5] = i + 0;
-                ++QuadCounter;
-            }
-        }
-    }
-    else {
-        u32 RemainingVertexCount = GetRemainingSize(&Assets->VertexArena)/sizeof(vertex);
-        u32 RemainingIndexCount = GetRemainingSize(&Assets->IndexArena)/sizeof(u16);
-        LWARN("Failed to create plane. Required %zu vertices and %zu indices, but there was only space for %zu and %zu", TotalVertexCount, IndexCount, RemainingVertexCount, RemainingIndexCount);
+// Names must match what the cooker writes. Only the test object is
+// loaded up front, picking needs it from the first frame. The rest of
+// the scene streams in through LoadSceneAssets.
+static inline void LoadAssets(assets *Assets) {
+    if (!OpenAssetPack(Assets, ASSET_PACK_PATH) || !GetMesh(Assets, LoadPackedMesh(Assets, "test_object"))) {
+        CreateTestObject(Assets);
     }
 }
 
-static inline void InitAssetStore(assets *Assets, memory_arena *Arena) {
-    size_t VertexStoreSize = 12*MiB;
-    void *VertexBase = PushSize(Arena, VertexStoreSize);
-    Assert(VertexBase);
-    Assets->VertexArena = CreateArena(VertexBase, VertexStoreSize);
-
-    size_t IndexStoreSize = 12*MiB;
-    void *IndexBase = PushSize(Arena, IndexStoreSize);
-    Assert(IndexBase);
-    Assets->IndexArena = CreateArena(IndexBase, IndexStoreSize);
+//
+// Upload queue
+//
+static void InitUploadQueue(upload_queue *Queue) {
+    for (u32 i = 0; i < ArrayCount(Queue->Cells); ++i) {
+        Queue->Cells[i].Sequence = i;
+    }
+    Queue->EnqueuePosition = 0;
+    Queue->DequeuePosition = 0;
 }
 
-static inline void LoadAssets(assets *Assets) {
-    CreatePlane(Assets, &Assets->Meshes[MESH_INDEX_TEST_OBJECT], vec3(), 8.f, 6.f, 24);
+// Safe from any thread. Returns false when the queue is full.
+static b32 PushUploadWork(upload_queue *Queue, upload_work *Work) {
+    u32 Mask = ArrayCount(Queue->Cells) - 1;
+    u32 Position = Queue->EnqueuePosition;
+    for (;;) {
+        upload_queue_cell *Cell = Queue->Cells + (Position & Mask);
+        i32 Difference = (i32)(Cell->Sequence - Position);
+        if (Difference == 0) {
+            u32 Original = PlatformAtomicCompareExchange(&Queue->EnqueuePosition, Position + 1, Position);
+            if (Original == Position) {
+                Cell->Work = *Work;
+                // Hands the filled cell to the consumer
+                PlatformAtomicExchange(&Cell->Sequence, Position + 1);
+                return true;
+            }
+            Position = Original;
+        }
+        else if (Difference < 0) {
+            // Still holds work from a lap ago
+            return false;
+        }
+        else {
+            // Another producer got this position first
+            Position = Queue->EnqueuePosition;
+        }
+    }
 }
 
-static inline upload_work *PushUploadWork(render_commands *Commands) {
-    Assert(Commands->UploadQueueCount < UINT32_MAX - 1);
-    upload_work *Result = NULL;
-    if (Commands->UploadQueueCount + 1 < Commands->MaxUploadQueueCount) {
-        Result = Commands->UploadQueue + Commands->UploadQueueCount;
-        ++Commands->UploadQueueCount;
+// Safe from any thread. Returns false when the queue is empty.
+static b32 PopUploadWork(upload_queue *Queue, upload_work *Work) {
+    u32 Mask = ArrayCount(Queue->Cells) - 1;
+    u32 Position = Queue->DequeuePosition;
+    for (;;) {
+        upload_queue_cell *Cell = Queue->Cells + (Position & Mask);
+        i32 Difference = (i32)(Cell->Sequence - (Position + 1));
+        if (Difference == 0) {
+            u32 Original = PlatformAtomicCompareExchange(&Queue->DequeuePosition, Position + 1, Position);
+            if (Original == Position) {
+                *Work = Cell->Work;
+                // Frees the cell for the producer a lap ahead
+                PlatformAtomicExchange(&Cell->Sequence, Position + Mask + 1);
+                return true;
+            }
+            Position = Original;
+        }
+        else if (Difference < 0) {
+            return false;
+        }
+        else {
+            Position = Queue->DequeuePosition;
+        }
     }
-    return Result;
 }
 
 #define PushRenderEntry(Commands, Type) (Type *)_PushRenderEntry(Commands, sizeof(Type), TYPE_##Type)
 static inline render_entry_header *_PushRenderEntry(render_commands *Commands, size_t Size, render_entry_type Type) {
     render_entry_header *Result = NULL;
     if (Commands->RenderEntrySize + Size < Commands->MaxRenderEntrySize) {
-        Result = Commands->Entries + Commands->RenderEntrySize;
+        Result = (render_entry_header *)(Commands->Entries + Commands->RenderEntrySize);
         Commands->RenderEntrySize += Size;
 
         Result->Type = Type;
@@ -210,7 +219,217 @@ static inline bounding_box GetMeshBoundingBox(mesh_object *Mesh) {
     return Box;
 }
 
+// LOD1 is used once the mesh's bounding sphere covers less than this
+// fraction of the view's height, and each level after it at half the
+// size of the one before
+#define MESH_LOD_SCREEN_FRACTION 0.5f
+static u32 SelectMeshLOD(camera *Camera, bounding_box *Box, u32 LODCount) {
+    f32 Radius = 0.5f*Magnitude(Box->Bounds);
+    f32 Distance = Magnitude(Box->Position - Camera->Position);
+    u32 LOD = 0;
+    if (Distance > Radius) {
+        f32 ScreenFraction = Radius/(Distance*tanf(0.5f*Camera->FOV));
+        f32 Threshold = MESH_LOD_SCREEN_FRACTION;
+        while (LOD + 1 < LODCount && ScreenFraction < Threshold) {
+            ++LOD;
+            Threshold *= 0.5f;
+        }
+    }
+    return LOD;
+}
+
+//
+// Scene streaming
+//
+// Everything but the test object is loaded by one job on the background
+// queue. Once the main thread has built the test object's BVH the job is
+// the only user of the asset arenas, so they need no locking. Each mesh
+// is queued for upload as soon as it's ready, and the renderer copies it
+// over as many frames as its upload budget needs.
+//
+// Packed meshes point into the mapping. Reading a byte of every page
+// here means the renderer's copy doesn't fault them in from disk.
+static void TouchMeshPages(mesh_object *Mesh) {
+    u8 volatile *Vertices = (u8 *)Mesh->Vertices;
+    for (size_t Offset = 0; Offset < Mesh->VertexCount*sizeof(vertex); Offset += 4096) {
+        (void)Vertices[Offset];
+    }
+    u8 volatile *Indices = (u8 *)Mesh->Indices;
+    for (size_t Offset = 0; Offset < Mesh->IndexCount*sizeof(u16); Offset += 4096) {
+        (void)Indices[Offset];
+    }
+}
+
+// Queues the mesh's upload, then hands it to the main thread. Meshes
+// are handed over in order. Returns false if the queue is full.
+static b32 QueueModelMesh(program_state *State, u32 ModelMeshIndex) {
+    Assert(State->LoadedModelMeshCount == ModelMeshIndex);
+    assets *Assets = &State->Assets;
+    u32 Slot = Assets->ModelMeshes[ModelMeshIndex].Slot;
+    upload_work Work = {};
+    Work.Operation = UPLOAD_OPERATION_CREATE;
+    Work.Slot = Slot;
+    Work.Mesh = Assets->Meshes + Slot;
+    if (!PushUploadWork(State->UploadQueue, &Work)) {
+        return false;
+    }
+    PlatformAtomicExchange(&State->LoadedModelMeshCount, ModelMeshIndex + 1);
+    return true;
+}
+
+static void FinishModelMesh(program_state *State, platform_work_queue *Queue, u32 ModelMeshIndex) {
+    u32 Slot = State->Assets.ModelMeshes[ModelMeshIndex].Slot;
+    State->MeshBounds[Slot] = GetMeshBoundingBox(State->Assets.Meshes + Slot);
+    if (Queue) {
+        while (!QueueModelMesh(State, ModelMeshIndex)) {
+            PlatformSleep(1);
+        }
+    }
+    else if (State->LoadedModelMeshCount == ModelMeshIndex) {
+        // Running inline at startup, nothing drains the queue yet. Once
+        // it's full the rest are queued by UpdateAndRender.
+        QueueModelMesh(State, ModelMeshIndex);
+    }
+}
+
+static PLATFORM_WORK_QUEUE_CALLBACK(LoadSceneAssets) {
+    program_state *State = (program_state *)Data;
+    assets *Assets = &State->Assets;
+    f64 BeginSeconds = PlatformGetSeconds();
+    if (Assets->Pack.Contents) {
+        for (u32 i = 0; i < MAX_MODEL_MESH_COUNT; ++i) {
+            char Name[64];
+            snprintf(Name, sizeof(Name), "scene/%u", i);
+            mesh_handle Handle = LoadPackedMesh(Assets, Name);
+            mesh_object *Mesh = GetMesh(Assets, Handle);
+            if (!Mesh) {
+                break;
+            }
+            TouchMeshPages(Mesh);
+            Assets->ModelMeshes[Assets->ModelMeshCount++] = Handle;
+            FinishModelMesh(State, Queue, Assets->ModelMeshCount - 1);
+        }
+    }
+    else {
+        // Optional, the scene works without it. A model is parsed and
+        // converted whole before its meshes are queued.
+        loaded_model *Model = LoadModel(Assets, MODEL_DIR "scene.glb", false);
+        if (Model) {
+            for (u32 i = 0; i < Model->MeshCount; ++i) {
+                FinishModelMesh(State, Queue, Model->FirstMesh + i);
+            }
+        }
+    }
+    LINFO("Scene assets loaded in %.2fms.", 1000.0*(PlatformGetSeconds() - BeginSeconds));
+}
+
+// Uses the render command helpers above
+#include "terrain.cpp"
+
+//
+// Sub-commands
+//
+
+static render_commands *BeginSubCommands(render_commands *Commands, u32 Index) {
+    Assert(!Commands->Parent);
+    Assert(Index < Commands->MaxSubCommandCount);
+
+    // Once chunks are handed out the push buffers stop being contiguous,
+    // so the next top level push has to open a new group.
+    Commands->CurrentLines = 0;
+    Commands->CurrentQuads = 0;
+
+    render_commands *Sub = Commands->SubCommands + Index;
+    u8 *Entries = Sub->Entries;
+    size_t MaxRenderEntrySize = Sub->MaxRenderEntrySize;
+    *Sub = {};
+    Sub->Entries = Entries;
+    Sub->MaxRenderEntrySize = MaxRenderEntrySize;
+    Sub->Parent = Commands;
+    Sub->Assets = Commands->Assets;
+    Sub->Camera = Commands->Camera;
+    Sub->WorldUp = Commands->WorldUp;
+    return Sub;
+}
+
+// Appends the sub-command entries in index order, so the merged stream
+// is the same no matter which worker finished first.
+static void MergeSubCommands(render_commands *Commands, u32 SubCommandCount) {
+    for (u32 i = 0; i < SubCommandCount; ++i) {
+        render_commands *Sub = Commands->SubCommands + i;
+        if (Commands->RenderEntrySize + Sub->RenderEntrySize < Commands->MaxRenderEntrySize) {
+            memcpy(Commands->Entries + Commands->RenderEntrySize, Sub->Entries, Sub->RenderEntrySize);
+            Commands->RenderEntrySize += Sub->RenderEntrySize;
+        }
+        else {
+            LWARN("Dropped %zu bytes of render entries from sub-commands %u.", Sub->RenderEntrySize, i);
+        }
+    }
+
+    // A failed chunk reservation still bumped the counts past the end
+    if (Commands->LineGroup.VertexCount > Commands->LineGroup.MaxVertexCount) {
+        Commands->LineGroup.VertexCount = Commands->LineGroup.MaxVertexCount;
+    }
+    if (Commands->LineGroup.IndexCount > Commands->LineGroup.MaxIndexCount) {
+        Commands->LineGroup.IndexCount = Commands->LineGroup.MaxIndexCount;
+    }
+    if (Commands->QuadGroup.VertexCount > Commands->QuadGroup.MaxVertexCount) {
+        Commands->QuadGroup.VertexCount = Commands->QuadGroup.MaxVertexCount;
+    }
+
+    Commands->CurrentLines = 0;
+    Commands->CurrentQuads = 0;
+}
+
+static inline b32 ReserveLineChunk(render_commands *Commands) {
+    b32 Result = false;
+    render_commands *Parent = Commands->Parent;
+    if (Parent) {
+        u32 Count = SUB_COMMANDS_LINE_CHUNK_VERTEX_COUNT;
+        u32 BaseVertex = PlatformAtomicAdd(&Parent->LineGroup.VertexCount, Count);
+        u32 FirstIndex = PlatformAtomicAdd(&Parent->LineGroup.IndexCount, Count);
+        if (BaseVertex + Count <= Parent->LineGroup.MaxVertexCount &&
+            FirstIndex + Count <= Parent->LineGroup.MaxIndexCount) {
+            Commands->LineGroup.Vertices = Parent->LineGroup.Vertices + BaseVertex;
+            Commands->LineGroup.VertexCount = 0;
+            Commands->LineGroup.MaxVertexCount = Count;
+            Commands->LineGroup.BaseVertex = BaseVertex;
+            Commands->LineGroup.Indices = Parent->LineGroup.Indices + FirstIndex;
+            Commands->LineGroup.IndexCount = 0;
+            Commands->LineGroup.MaxIndexCount = Count;
+            Commands->LineGroup.FirstIndex = FirstIndex;
+            Commands->CurrentLines = 0;
+            Result = true;
+        }
+    }
+    return Result;
+}
+
+static inline b32 ReserveQuadChunk(render_commands *Commands) {
+    b32 Result = false;
+    render_commands *Parent = Commands->Parent;
+    if (Parent) {
+        u32 Count = SUB_COMMANDS_QUAD_CHUNK_VERTEX_COUNT;
+        u32 BaseVertex = PlatformAtomicAdd(&Parent->QuadGroup.VertexCount, Count);
+        if (BaseVertex + Count <= Parent->QuadGroup.MaxVertexCount) {
+            Commands->QuadGroup.Vertices = Parent->QuadGroup.Vertices + BaseVertex;
+            Commands->QuadGroup.ObjectIDs = Parent->QuadGroup.ObjectIDs + BaseVertex;
+            Commands->QuadGroup.VertexCount = 0;
+            Commands->QuadGroup.MaxVertexCount = Count;
+            Commands->QuadGroup.BaseVertex = BaseVertex;
+            Commands->CurrentQuads = 0;
+            Result = true;
+        }
+    }
+    return Result;
+}
+
 static inline void PushLine(render_commands *Commands, vec3 P0, vec3 P1, vec4 Color = vec4(0.f, 0.f, 0.f, 1.f)) {
+    if (!(Commands->LineGroup.VertexCount + 2 < Commands->LineGroup.MaxVertexCount &&
+          Commands->LineGroup.IndexCount + 2 < Commands->LineGroup.MaxIndexCount)) {
+        ReserveLineChunk(Commands);
+    }
+
     if (Commands->LineGroup.VertexCount + 2 < Commands->LineGroup.MaxVertexCount &&
         Commands->LineGroup.IndexCount + 2 < Commands->LineGroup.MaxIndexCount) {
 
@@ -220,11 +439,15 @@ static inline void PushLine(render_commands *Commands, vec3 P0, vec3 P1, vec4 Co
 
         if (!Commands->CurrentLines) {
             Commands->CurrentLines = PushRenderEntry(Commands, render_entry_line_group);
+            if (!Commands->CurrentLines) {
+                return;
+            }
             Commands->CurrentLines->Vertices = Commands->LineGroup.Vertices + Commands->LineGroup.VertexCount;
             Commands->CurrentLines->Indices = Commands->LineGroup.Indices + Commands->LineGroup.IndexCount;
             Commands->CurrentLines->VertexCount = 0;
             Commands->CurrentLines->IndexCount = 0;
-            Commands->CurrentLines->IndexOffset = Commands->LineGroup.VertexCount;
+            Commands->CurrentLines->FirstIndex = Commands->LineGroup.FirstIndex + Commands->LineGroup.IndexCount;
+            Commands->CurrentLines->BaseVertex = Commands->LineGroup.BaseVertex + Commands->LineGroup.VertexCount;
         }
 
         render_entry_line_group *Lines = Commands->CurrentLines;
@@ -295,32 +518,30 @@ static inline void DrawAxes(render_commands *Commands, vec3 P) {
     PushLine(Commands, P, P + vec3(0.f, 0.f, 1.f), COLOR_BLUE);
 }
 
-static inline void PushQuad(render_commands *Commands, vec3 *Positions, vec4 *Colors, vec2 *UVs) {
-    if (Commands->QuadGroup.VertexCount + 4 < Commands->QuadGroup.MaxVertexCount &&
-        Commands->QuadGroup.IndexCount + 6 < Commands->QuadGroup.MaxIndexCount) {
+static inline vertex *PushQuad(render_commands *Commands, vec3 *Positions, vec4 *Colors, vec2 *UVs, u32 ObjectID = OBJECT_ID_NONE) {
+    vertex *Result = NULL;
+    if (!(Commands->QuadGroup.VertexCount + 4 < Commands->QuadGroup.MaxVertexCount)) {
+        ReserveQuadChunk(Commands);
+    }
 
-        if (Commands->CurrentQuads && !(Commands->CurrentQuads->IndexCount < UINT16_MAX - 6)) {
-            Commands->CurrentQuads = 0;
-        }
+    if (Commands->QuadGroup.VertexCount + 4 < Commands->QuadGroup.MaxVertexCount) {
 
         if (!Commands->CurrentQuads) {
             Commands->CurrentQuads = PushRenderEntry(Commands, render_entry_quad_group);
+            if (!Commands->CurrentQuads) {
+                return Result;
+            }
             Commands->CurrentQuads->Vertices = Commands->QuadGroup.Vertices + Commands->QuadGroup.VertexCount;
-            Commands->CurrentQuads->Indices = Commands->QuadGroup.Indices + Commands->QuadGroup.IndexCount;
+            Commands->CurrentQuads->ObjectIDs = Commands->QuadGroup.ObjectIDs + Commands->QuadGroup.VertexCount;
             Commands->CurrentQuads->VertexCount = 0;
-            Commands->CurrentQuads->IndexCount = 0;
-            Commands->CurrentQuads->IndexOffset = Commands->QuadGroup.VertexCount;
+            Commands->CurrentQuads->BaseVertex = Commands->QuadGroup.BaseVertex + Commands->QuadGroup.VertexCount;
         }
 
         render_entry_quad_group *Quads = Commands->CurrentQuads;
 
-        u32 IndexOffset = Quads->VertexCount;
         vertex *Vertices = Quads->Vertices + Quads->VertexCount;
         Quads->VertexCount += 4;
 
-        u16 *Indices = Quads->Indices + Quads->IndexCount;
-        Quads->IndexCount += 6;
-
         Vertices[0].Position = Positions[0];
         Vertices[1].Position = Positions[1];
         Vertices[2].Position = Positions[2];
@@ -336,19 +557,19 @@ static inline void PushQuad(render_commands *Commands, vec3 *Positions, vec4 *Co
         Vertices[2].UV = UVs[2];
         Vertices[3].UV = UVs[3];
 
-        Indices[0] = IndexOffset + 0;
-        Indices[1] = IndexOffset + 1;
-        Indices[2] = IndexOffset + 2;
-        Indices[3] = IndexOffset + 2;
-        Indices[4] = IndexOffset + 3;
-        Indices[5] = IndexOffset + 0;
+        u32 *ObjectIDs = Quads->ObjectIDs + (Vertices - Quads->Vertices);
+        ObjectIDs[0] = ObjectID;
+        ObjectIDs[1] = ObjectID;
+        ObjectIDs[2] = ObjectID;
+        ObjectIDs[3] = ObjectID;
 
         Commands->QuadGroup.VertexCount += 4;
-        Commands->QuadGroup.IndexCount += 6;
+        Result = Vertices;
     }
+    return Result;
 };
 
-static void DrawCircle(render_commands *Commands, vec3 C, vec2 Extent, vec4 Color) {
+static vertex *DrawCircle(render_commands *Commands, vec3 C, vec2 Extent, vec4 Color, u32 ObjectID) {
     vec3 Positions[4] = {};
     Positions[0] = C + vec3(-Extent.x/2.f, -Extent.y/2.f, 0.f);
     Positions[1] = C + vec3( Extent.x/2.f, -Extent.y/2.f, 0.f);
@@ -367,7 +588,33 @@ static void DrawCircle(render_commands *Commands, vec3 C, vec2 Extent, vec4 Colo
     UVs[2] = vec2(1.f, 1.f);
     UVs[3] = vec2(0.f, 1.f);
 
-    PushQuad(Commands, Positions, Colors, UVs);
+    vertex *Result = PushQuad(Commands, Positions, Colors, UVs, ObjectID);
+    return Result;
+}
+
+static inline void MarkCircleRecordDirty(program_state *State, u32 Index) {
+    if (!State->CircleRecordDirty[Index]) {
+        State->CircleRecordDirty[Index] = true;
+        State->DirtyCircleIndices[State->DirtyCircleCount++] = Index;
+    }
+}
+
+// Restarts the record's motion from the circle's current position. A
+// circle that isn't alive gets a zero radius so the GPU collapses it.
+static inline void UpdateCircleRecord(program_state *State, circle_object *Circle, b32 Alive = true) {
+    if (State->RetainedCircles) {
+        u32 Index = (u32)(Circle - State->Circles);
+        circle_record *Record = State->CircleRecords + Index;
+        Record->Color = Circle->Color;
+        Record->StartPosition = Circle->Position;
+        Record->SpawnTime = (f32)State->Time;
+        Record->Velocity = Circle->Velocity;
+        Record->Radius = Alive ? Circle->Radius : 0.f;
+        if (State->CircleRecordCount < Index + 1) {
+            State->CircleRecordCount = Index + 1;
+        }
+        MarkCircleRecordDirty(State, Index);
+    }
 }
 
 static inline void DestroyCircle(program_state *State, circle_object *Circle) {
@@ -387,9 +634,10 @@ static inline void DestroyCircle(program_state *State, circle_object *Circle) {
         }
     }
 
-    if (State->HotCircle = Circle) {
+    if (State->HotCircle == Circle) {
         State->HotCircle = NULL;
     }
+    UpdateCircleRecord(State, Circle, false);
 
     Circle->Next = State->FirstFreeCircle;
     State->FirstFreeCircle = Circle;
@@ -415,6 +663,39 @@ static inline circle_object *CreateCircle(program_state *State) {
     return Result;
 }
 
+static PLATFORM_WORK_QUEUE_CALLBACK(UpdateCirclesJob) {
+    circle_update_job *Job = (circle_update_job *)Data;
+    circle_object *Circle = Job->First;
+    for (u32 i = 0; i < Job->Count; ++i) {
+        Assert(Circle);
+        vec4 Color = Circle->Color;
+        u32 ObjectID = CIRCLE_OBJECT_ID(Circle - Job->Circles);
+        if (Circle == Job->HotCircle) {
+            Color = vec4(1.f);
+        }
+        if (Job->Integrate && Circle != Job->DraggedCircle) {
+            Circle->Position = Circle->Position + Job->dt*Circle->Velocity;
+        }
+        if (Job->Instances) {
+            circle_instance *Instance = Job->Instances + i;
+            Instance->Color = Color;
+            Instance->Position = Circle->Position;
+            Instance->Radius = Circle->Radius;
+            Instance->ObjectID = ObjectID;
+            if (Circle == Job->DraggedCircle) {
+                Job->DraggedInstance = Instance;
+            }
+        }
+        else {
+            vertex *Vertices = DrawCircle(Job->Commands, Circle->Position, vec2(2.f*Circle->Radius), Color, ObjectID);
+            if (Circle == Job->DraggedCircle) {
+                Job->DraggedVertices = Vertices;
+            }
+        }
+        Circle = Circle->Next;
+    }
+}
+
 static void UpdateAndRender(program_memory *Memory, render_commands *Commands, program_input *Input, f64 Frametime) {
     program_state *State = (program_state *)Memory->PersistantMemory;
     if (!Memory->Initialized) {
@@ -427,23 +708,82 @@ static void UpdateAndRender(program_memory *Memory, render_commands *Commands, p
             State->Circles[i - 1].Next = State->Circles + i;
         }
 
+        State->SampleCount = DEFAULT_MSAA_SAMPLE_COUNT;
+        State->MeshBudgetBytes = DEFAULT_MESH_BUDGET_BYTES;
+
         GlobalRandom = InitRandom(12);
         InitCamera(&State->Camera);
         InitAssetStore(&State->Assets, &State->PermanentArena);
+        InitTerrain(&State->Terrain, &State->PermanentArena);
+        State->UploadQueue = Commands->UploadQueue;
+        f64 LoadBeginSeconds = PlatformGetSeconds();
         LoadAssets(&State->Assets);
-
-        State->TestBox = GetMeshBoundingBox(&State->Assets.Meshes[MESH_INDEX_TEST_OBJECT]);
-
-        upload_work *Work = PushUploadWork(Commands);
-        if (Work) {
-            Work->Index = MESH_INDEX_TEST_OBJECT;
-            Work->Mesh = &State->Assets.Meshes[MESH_INDEX_TEST_OBJECT];
+        LINFO("Assets loaded in %.2fms.", 1000.0*(PlatformGetSeconds() - LoadBeginSeconds));
+
+        State->TestObject = FindMesh(&State->Assets, "test_object");
+        u32 TestSlot = State->TestObject.Slot;
+        mesh_object *TestMesh = GetMesh(&State->Assets, State->TestObject);
+        Assert(TestMesh);
+        BuildMeshBVH(&State->Assets.BVHArena, &State->Assets.ScratchArena, TestMesh,
+                &State->Assets.BVHs[TestSlot], "test_object");
+        State->TestBox = GetMeshBoundingBox(TestMesh);
+        State->MeshBounds[TestSlot] = State->TestBox;
+
+        upload_work Work = {};
+        Work.Operation = UPLOAD_OPERATION_CREATE;
+        Work.Slot = TestSlot;
+        Work.Mesh = TestMesh;
+        PushUploadWork(State->UploadQueue, &Work);
+
+        if (Memory->BackgroundQueue) {
+            PlatformAddWorkEntry(Memory->BackgroundQueue, LoadSceneAssets, State);
+        }
+        else {
+            LoadSceneAssets(NULL, State);
         }
     }
+    // WASD pans over the terrain, which streams in around the camera
+    vec3 Pan = vec3();
+    if (ButtonDown(Input, BUTTON_KEY_W)) {
+        Pan.y += 1.f;
+    }
+    if (ButtonDown(Input, BUTTON_KEY_S)) {
+        Pan.y -= 1.f;
+    }
+    if (ButtonDown(Input, BUTTON_KEY_D)) {
+        Pan.x += 1.f;
+    }
+    if (ButtonDown(Input, BUTTON_KEY_A)) {
+        Pan.x -= 1.f;
+    }
+    State->Camera.Position = State->Camera.Position + (CAMERA_PAN_SPEED*(f32)Frametime)*Pan;
+
     Commands->Camera = &State->Camera;
     Commands->Assets = &State->Assets;
     Commands->WorldUp = vec3(0.f, 0.f, 1.f);
 
+    if (!Memory->BackgroundQueue) {
+        // The scene was loaded inline, whatever didn't fit the upload
+        // queue then goes in as the renderer drains it
+        while (State->LoadedModelMeshCount < State->Assets.ModelMeshCount &&
+                QueueModelMesh(State, State->LoadedModelMeshCount)) {
+        }
+    }
+
+    // Opaque meshes go first so everything blended lands on top of them
+    u32 LoadedModelMeshCount = State->LoadedModelMeshCount;
+    for (u32 i = 0; i < LoadedModelMeshCount; ++i) {
+        render_entry_mesh *Entry = PushRenderEntry(Commands, render_entry_mesh);
+        if (Entry) {
+            Entry->Slot = State->Assets.ModelMeshes[i].Slot;
+            Entry->LOD = SelectMeshLOD(&State->Camera, State->MeshBounds + Entry->Slot,
+                    State->Assets.Meshes[Entry->Slot].LODCount);
+        }
+    }
+    UpdateTerrain(&State->Terrain, &State->Assets, Memory->BackgroundQueue, Commands, State->Camera.Position);
+    PushTerrain(&State->Terrain, Commands);
+    State->Time += Frametime;
+
     if (ButtonDown(Input, BUTTON_KEY_ESCAPE)) {
         circle_object *Circle = State->FirstActiveCircle;
         if (Circle) {
@@ -458,6 +798,56 @@ static void UpdateAndRender(program_memory *Memory, render_commands *Commands, p
             Circle->Position = vec3(RandomRange(&GlobalRandom, -5.f, 5.f), RandomRange(&GlobalRandom, -5.f, 5.f), RandomRange(&GlobalRandom, -5.f, 5.f));
             Circle->Velocity = Normalized(vec3(RandomBilateral(&GlobalRandom), RandomBilateral(&GlobalRandom), RandomBilateral(&GlobalRandom)));
             Circle->Radius = RandomRange(&GlobalRandom, 0.35f, 1.15f);
+            UpdateCircleRecord(State, Circle);
+        }
+    }
+
+    // Circles are anti-aliased in the shader, so MSAA only matters for
+    // mesh and line edges. M cycles 1, 2, 4, 8, 16 samples.
+    if (ButtonPressed(Input, BUTTON_KEY_M)) {
+        State->SampleCount = (State->SampleCount >= 16) ? 1 : 2*State->SampleCount;
+        LINFO("MSAA samples: %u", State->SampleCount);
+    }
+    Commands->SampleCount = State->SampleCount;
+    Commands->MeshBudgetBytes = State->MeshBudgetBytes;
+
+    if (ButtonPressed(Input, BUTTON_KEY_R)) {
+        State->RetainedCircles = !State->RetainedCircles;
+        if (State->RetainedCircles) {
+            // Records went stale while in immediate mode, rebuild them all
+            for (u32 i = 0; i < State->CircleRecordCount; ++i) {
+                State->CircleRecords[i].Radius = 0.f;
+                MarkCircleRecordDirty(State, i);
+            }
+            for (circle_object *Circle = State->FirstActiveCircle; Circle; Circle = Circle->Next) {
+                UpdateCircleRecord(State, Circle);
+            }
+        }
+        LINFO("Retained circles: %s", State->RetainedCircles ? "on" : "off");
+    }
+
+    if (ButtonPressed(Input, BUTTON_KEY_O)) {
+        const char *ModeNames[CIRCLE_RENDER_MODE_COUNT] = {"blended", "opaque", "oit"};
+        State->CircleRenderMode = (circle_render_mode)((State->CircleRenderMode + 1) % CIRCLE_RENDER_MODE_COUNT);
+        LINFO("Circle render mode: %s", ModeNames[State->CircleRenderMode]);
+    }
+    b32 UseInstances = (State->CircleRenderMode != CIRCLE_RENDER_MODE_BLENDED);
+
+    // GPU picking uses whatever was drawn under the mouse last frame, so
+    // it costs the same however many objects there are. OIT circles
+    // don't write IDs, the mesh or background behind them is picked.
+    if (ButtonPressed(Input, BUTTON_KEY_G)) {
+        State->GPUPicking = !State->GPUPicking;
+        LINFO("GPU picking: %s", State->GPUPicking ? "on" : "off");
+    }
+    u32 PickedObjectID = Commands->PickedObjectID;
+    circle_object *PickedCircle = NULL;
+    if (State->GPUPicking && PickedObjectID != OBJECT_ID_NONE && !(PickedObjectID & OBJECT_ID_MESH_BIT)) {
+        // The ID is a frame old. If that circle was destroyed since, it's
+        // not in the active list and never matches below.
+        u32 Index = PickedObjectID - 1;
+        if (Index < ArrayCount(State->Circles)) {
+            PickedCircle = State->Circles + Index;
         }
     }
 
@@ -466,42 +856,179 @@ static void UpdateAndRender(program_memory *Memory, render_commands *Commands, p
     vec3 Ray = Normalized(MouseP - CameraP);
     vec3 N = vec3(0.f, 0.f, 1.f);
 
+    if (State->GPUPicking) {
+        // Any mesh can be picked, only the ones with bounds get outlined
+        if (PickedObjectID & OBJECT_ID_MESH_BIT) {
+            u32 Slot = PickedObjectID & ~OBJECT_ID_MESH_BIT;
+            if (Slot < MAX_MESH_COUNT) {
+                bounding_box *Bounds = State->MeshBounds + Slot;
+                if (Bounds->Bounds.x != 0.f || Bounds->Bounds.y != 0.f || Bounds->Bounds.z != 0.f) {
+                    DrawBoundingBox(Commands, *Bounds);
+                }
+                if (ButtonPressed(Input, BUTTON_MOUSE_LEFT)) {
+                    LINFO("Picked mesh slot %u from the ID buffer.", Slot);
+                }
+            }
+        }
+    }
+    else {
+        // The test object is picked against its triangles. Hovering outlines
+        // it and marks the hit, clicking logs what was hit.
+        f64 PickBeginSeconds = PlatformGetSeconds();
+        bvh_hit MeshHit = {};
+        b32 MeshHovered = RaycastMeshBVH(&State->Assets.BVHs[State->TestObject.Slot], CameraP, Ray, FLT_MAX, &MeshHit);
+        f64 PickSeconds = PlatformGetSeconds() - PickBeginSeconds;
+        if (MeshHovered) {
+            vec3 HitP = CameraP + MeshHit.t*Ray;
+            DrawBoundingBox(Commands, State->TestBox);
+            DrawAxes(Commands, HitP);
+            if (ButtonPressed(Input, BUTTON_MOUSE_LEFT)) {
+                LINFO("Picked test object triangle %u at (%.2f, %.2f, %.2f) in %.2fus.",
+                        MeshHit.Triangle, HitP.x, HitP.y, HitP.z, 1000000.0*PickSeconds);
+            }
+        }
+    }
+
+    //
+    // Picking and dragging run serially, then the circles are split into
+    // contiguous runs that integrate and emit their quads in parallel.
+    // In retained mode nothing is emitted, positions are evaluated
+    // analytically to match the vertex shader.
+    //
+    u32 CirclesPerJob = (State->CircleCount + MAX_CIRCLE_JOB_COUNT - 1)/MAX_CIRCLE_JOB_COUNT;
+    if (CirclesPerJob < MIN_CIRCLES_PER_JOB) {
+        CirclesPerJob = MIN_CIRCLES_PER_JOB;
+    }
+    u32 JobCount = 0;
+    circle_update_job Jobs[MAX_CIRCLE_JOB_COUNT] = {};
+    circle_object *DraggedCircle = NULL;
+
+    u32 CircleIndex = 0;
     circle_object *Circle = State->FirstActiveCircle;
     while (Circle) {
-        b32 Destroy = false;
-        vec4 Color = Circle->Color;
-        vec3 ProjectedMouseP = vec3();
-        f32 t = 0.f;
+        if (CircleIndex % CirclesPerJob == 0) {
+            Assert(JobCount < ArrayCount(Jobs));
+            Jobs[JobCount].First = Circle;
+            Jobs[JobCount].Instances = UseInstances ? State->CircleInstances + CircleIndex : NULL;
+            ++JobCount;
+        }
+        ++Jobs[JobCount - 1].Count;
+        ++CircleIndex;
+
+        if (State->RetainedCircles) {
+            circle_record *Record = State->CircleRecords + (Circle - State->Circles);
+            Circle->Position = Record->StartPosition + CIRCLE_SPEED*((f32)State->Time - Record->SpawnTime)*Record->Velocity;
+        }
 
         f32 PlaneRayCosAngle = Dot(N, Ray);
         if (PlaneRayCosAngle < 0.000001f) {
-            t = Dot(N, Circle->Position - CameraP)/PlaneRayCosAngle;
-            ProjectedMouseP = CameraP + t*Ray;
+            f32 t = Dot(N, Circle->Position - CameraP)/PlaneRayCosAngle;
+            vec3 ProjectedMouseP = CameraP + t*Ray;
             f32 DistanceToMouse = Magnitude(ProjectedMouseP - Circle->Position);
-            if (!State->HotCircle || (Circle->Position.z > State->HotCircle->Position.z)) {
-                if (DistanceToMouse < Circle->Radius) {
+            b32 LeftClickDown = ButtonDown(Input, BUTTON_MOUSE_LEFT);
+            b32 UnderMouse;
+            if (State->GPUPicking) {
+                // Already the nearest visible circle, a drag keeps its circle
+                UnderMouse = (Circle == PickedCircle);
+                if (UnderMouse && !LeftClickDown) {
                     State->HotCircle = Circle;
                 }
             }
+            else {
+                UnderMouse = (DistanceToMouse < Circle->Radius);
+                if (!State->HotCircle || (Circle->Position.z > State->HotCircle->Position.z)) {
+                    if (UnderMouse) {
+                        State->HotCircle = Circle;
+                    }
+                }
+            }
 
-            Circle->Position = Circle->Position + 0.25f*Frametime*Circle->Velocity;
             if (Circle == State->HotCircle) {
-                b32 LeftClickDown = ButtonDown(Input, BUTTON_MOUSE_LEFT);
-                if (DistanceToMouse > Circle->Radius && !LeftClickDown) {
+                if (!UnderMouse && !LeftClickDown) {
                     State->HotCircle = NULL;
                 }
-                else {
-                    if (LeftClickDown) {
-                        Circle->Position = ProjectedMouseP;
-                    }
-                    Color = vec4(1.f);
+                else if (LeftClickDown) {
+                    Circle->Position = ProjectedMouseP;
+                    DraggedCircle = Circle;
+                    UpdateCircleRecord(State, Circle);
                 }
             }
         }
-        DrawCircle(Commands, Circle->Position, vec2(2.f*Circle->Radius), Color);
         Circle = Circle->Next;
     }
 
+    if (State->RetainedCircles && !UseInstances) {
+        JobCount = 0;
+    }
+
+    Assert(JobCount <= Commands->MaxSubCommandCount);
+    for (u32 i = 0; i < JobCount; ++i) {
+        Jobs[i].Commands = BeginSubCommands(Commands, i);
+        Jobs[i].Circles = State->Circles;
+        Jobs[i].HotCircle = State->HotCircle;
+        Jobs[i].DraggedCircle = DraggedCircle;
+        Jobs[i].Integrate = !State->RetainedCircles;
+        Jobs[i].dt = CIRCLE_SPEED*(f32)Frametime;
+    }
+
+    b32 RunParallel = (Memory->WorkQueue && JobCount > 1);
+    for (u32 i = 0; i < JobCount; ++i) {
+        if (RunParallel) {
+            PlatformAddWorkEntry(Memory->WorkQueue, UpdateCirclesJob, Jobs + i);
+        }
+        else {
+            UpdateCirclesJob(NULL, Jobs + i);
+        }
+    }
+    if (RunParallel) {
+        PlatformCompleteAllWork(Memory->WorkQueue);
+    }
+    MergeSubCommands(Commands, JobCount);
+
+    State->DraggedCircle = DraggedCircle;
+    State->DraggedVertices = NULL;
+    State->DraggedInstance = NULL;
+    for (u32 i = 0; i < JobCount; ++i) {
+        if (Jobs[i].DraggedVertices) {
+            State->DraggedVertices = Jobs[i].DraggedVertices;
+        }
+        if (Jobs[i].DraggedInstance) {
+            State->DraggedInstance = Jobs[i].DraggedInstance;
+        }
+    }
+
+    if (UseInstances) {
+        u32 InstanceCount = CircleIndex;
+        circle_instance *Instances = State->CircleInstances;
+
+        // Opaque circles go front to back by distance from the camera.
+        // OIT doesn't depend on submission order and skips the sort.
+        if (State->CircleRenderMode == CIRCLE_RENDER_MODE_OPAQUE) {
+            for (u32 i = 0; i < InstanceCount; ++i) {
+                vec3 ToCamera = State->CircleInstances[i].Position - CameraP;
+                State->CircleSortEntries[i].SortKey = SortKeyFromF32(Dot(ToCamera, ToCamera));
+                State->CircleSortEntries[i].Index = i;
+            }
+            RadixSort(InstanceCount, State->CircleSortEntries, State->CircleSortTemp);
+            u32 DraggedIndex = State->DraggedInstance ? (u32)(State->DraggedInstance - State->CircleInstances) : InstanceCount;
+            for (u32 i = 0; i < InstanceCount; ++i) {
+                u32 Index = State->CircleSortEntries[i].Index;
+                State->SortedCircleInstances[i] = State->CircleInstances[Index];
+                if (Index == DraggedIndex) {
+                    State->DraggedInstance = State->SortedCircleInstances + i;
+                }
+            }
+            Instances = State->SortedCircleInstances;
+        }
+
+        render_entry_circle_instances *Entry = PushRenderEntry(Commands, render_entry_circle_instances);
+        if (Entry) {
+            Entry->Mode = State->CircleRenderMode;
+            Entry->Instances = Instances;
+            Entry->InstanceCount = InstanceCount;
+        }
+    }
+
     if (State->HotCircle) {
         if (ButtonPressed(Input, BUTTON_MOUSE_RIGHT)) {
             DestroyCircle(State, State->HotCircle);
@@ -509,5 +1036,64 @@ static void UpdateAndRender(program_memory *Memory, render_commands *Commands, p
         }
     }
 
+    if (State->RetainedCircles && !UseInstances) {
+        render_entry_circle_records *Entry = PushRenderEntry(Commands, render_entry_circle_records);
+        if (Entry) {
+            Entry->Records = State->CircleRecords;
+            Entry->RecordCount = State->CircleRecordCount;
+            Entry->DirtyIndices = State->DirtyCircleIndices;
+            Entry->DirtyCount = State->DirtyCircleCount;
+            Entry->Time = (f32)State->Time;
+            Entry->Speed = CIRCLE_SPEED;
+            Entry->HotIndex = State->HotCircle ? (i32)(State->HotCircle - State->Circles) : -1;
+
+            for (u32 i = 0; i < State->DirtyCircleCount; ++i) {
+                State->CircleRecordDirty[State->DirtyCircleIndices[i]] = false;
+            }
+            State->DirtyCircleCount = 0;
+        }
+    }
+
     Commands->CircleCount = State->CircleCount;
 }
+
+// The platform calls this between UpdateAndRender and EndFrame with a
+// fresher GlobalMouseP. The dragged circle follows it, and the geometry
+// it already emitted is patched in place, so the drag doesn't lag by the
+// time spent simulating and building the frame.
+static void LateLatchDrag(program_memory *Memory) {
+    program_state *State = (program_state *)Memory->PersistantMemory;
+    circle_object *Circle = State->DraggedCircle;
+    if (!Memory->Initialized || !Circle) {
+        return;
+    }
+
+    vec3 MouseP = GetMouseWorldPosition(&State->Camera);
+    vec3 CameraP = State->Camera.Position;
+    vec3 Ray = Normalized(MouseP - CameraP);
+    vec3 N = vec3(0.f, 0.f, 1.f);
+    f32 PlaneRayCosAngle = Dot(N, Ray);
+    if (PlaneRayCosAngle < 0.000001f) {
+        f32 t = Dot(N, Circle->Position - CameraP)/PlaneRayCosAngle;
+        vec3 ProjectedMouseP = CameraP + t*Ray;
+        vec3 Delta = ProjectedMouseP - Circle->Position;
+        Circle->Position = ProjectedMouseP;
+
+        if (State->DraggedVertices) {
+            for (u32 i = 0; i < 4; ++i) {
+                State->DraggedVertices[i].Position = State->DraggedVertices[i].Position + Delta;
+            }
+        }
+        if (State->DraggedInstance) {
+            State->DraggedInstance->Position = ProjectedMouseP;
+        }
+        if (State->RetainedCircles) {
+            // Already in this frame's dirty list from the drag, only the
+            // contents change. Marking it again would clobber the list
+            // the pushed entry points at.
+            circle_record *Record = State->CircleRecords + (Circle - State->Circles);
+            Record->StartPosition = ProjectedMouseP;
+            Record->SpawnTime = (f32)State->Time;
+        }
+    }
+}
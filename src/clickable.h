@@ -4,6 +4,10 @@ struct program_memory {
     b32 Initialized;
     void *PersistantMemory;
     size_t PersistantMemorySize;
+
+    platform_work_queue *WorkQueue;
+    // Long running jobs that may span frames, never waited on
+    platform_work_queue *BackgroundQueue;
 };
 
 struct camera {
@@ -26,42 +30,228 @@ struct line_vertex {
     vec3 Position;
 };
 
+// Indices are u16 and relative to their part's BaseVertex, so a part
+// reaches at most MAX_MESH_PART_VERTEX_COUNT vertices. Bigger meshes are
+// split into several parts, which is 16-bit index bandwidth for every
+// mesh at the cost of a draw per part. Parts may overlap in Vertices.
+#define MAX_MESH_PART_VERTEX_COUNT (0xFFFF + 1)
+#define MAX_MESH_PART_COUNT 16
+struct mesh_part {
+    u32 BaseVertex;
+    u32 VertexCount;
+    u32 FirstIndex;
+    u32 IndexCount;
+};
+
+// LODs index the same vertices as LOD0, each one with about half the
+// triangles of the one before. Their indices follow LOD0's in Indices,
+// and IndexCount covers all of them. Only single part meshes get LODs.
+#define MAX_MESH_LOD_COUNT 4
+struct mesh_lod {
+    u32 FirstPart;
+    u32 PartCount;
+};
+
 struct mesh_object {
     vertex *Vertices;
     u32 VertexCount;
 
     u16 *Indices;
     u32 IndexCount;
+
+    mesh_part Parts[MAX_MESH_PART_COUNT];
+    u32 PartCount;
+    mesh_lod LODs[MAX_MESH_LOD_COUNT];
+    u32 LODCount;
+};
+
+//
+// Triangle BVH for ray picking, built over LOD0. Nodes are depth first,
+// so an interior node's first child is the node after it and MissIndex
+// is the first node past its subtree, which is where traversal goes when
+// the ray misses the node or is done with a leaf.
+//
+#define BVH_LEAF_TRIANGLE_COUNT_BITS 4
+#define BVH_LEAF_TRIANGLE_COUNT_MASK ((1 << BVH_LEAF_TRIANGLE_COUNT_BITS) - 1)
+struct bvh_node {
+    vec3 Min;
+    u32 MissIndex;
+    vec3 Max;
+    // Zero for interior nodes, FirstBlock << BVH_LEAF_TRIANGLE_COUNT_BITS
+    // | TriangleCount for leaves
+    u32 Leaf;
+};
+
+// Four triangles, one per lane, laid out for SSE. Lanes past the leaf's
+// triangle count are degenerate and never hit.
+struct bvh_triangle_block {
+    f32 V0[3][4];
+    f32 Edge1[3][4];
+    f32 Edge2[3][4];
+    // Triangle number in LOD0, counting through its parts in order
+    u32 Triangles[4];
+};
+
+struct mesh_bvh {
+    bvh_node *Nodes;
+    u32 NodeCount;
+    bvh_triangle_block *Blocks;
+    u32 BlockCount;
+};
+
+struct bvh_hit {
+    f32 t;
+    u32 Triangle;
+};
+
+//
+// Heightfield terrain, streamed in square chunks around the camera.
+// Chunks are generated on the background queue into fixed slots, handed
+// to the renderer through the upload queue once they're done, and
+// dropped once the camera has moved away from them.
+//
+#define TERRAIN_CHUNK_QUAD_COUNT 32
+#define TERRAIN_CHUNK_VERTEX_COUNT ((TERRAIN_CHUNK_QUAD_COUNT + 1)*(TERRAIN_CHUNK_QUAD_COUNT + 1))
+#define TERRAIN_CHUNK_INDEX_COUNT (6*TERRAIN_CHUNK_QUAD_COUNT*TERRAIN_CHUNK_QUAD_COUNT)
+#define TERRAIN_CHUNK_SIZE 16.f
+// In chunks from the camera's chunk. Dropping one further out than
+// loading keeps chunks on the edge from flickering in and out, and
+// bounds how many can be alive at once.
+#define TERRAIN_LOAD_RADIUS 3
+#define TERRAIN_DROP_RADIUS (TERRAIN_LOAD_RADIUS + 1)
+#define MAX_TERRAIN_CHUNK_COUNT ((2*TERRAIN_DROP_RADIUS + 1)*(2*TERRAIN_DROP_RADIUS + 1))
+#define MAX_TERRAIN_JOBS_IN_FLIGHT 4
+#define MAX_TERRAIN_UPLOADS_PER_FRAME 2
+
+//
+// Mesh registry
+//
+// Meshes are looked up by the 64-bit hash of their name in an open
+// addressing table with linear probing, and live in dense slots that
+// every per-mesh array is indexed by. A released slot is reused with
+// its generation bumped, so a stale mesh_handle resolves to nothing
+// instead of to whatever took its place.
+//
+#define MAX_MESH_COUNT 4096
+// Power of two, at most half full so probe runs stay short
+#define MESH_REGISTRY_CELL_COUNT (2*MAX_MESH_COUNT)
+#define MESH_SLOT_NONE 0xFFFFFFFF
+struct mesh_handle {
+    u32 Slot;
+    // Starts at one, so a zeroed handle never resolves
+    u32 Generation;
+};
+
+struct mesh_registry_cell {
+    u64 NameHash;
+    // MESH_SLOT_NONE for empty cells
+    u32 Slot;
 };
 
-enum mesh_index {
-    MESH_INDEX_LINE_PUSH_BUFFER,
-    MESH_INDEX_QUAD_PUSH_BUFFER,
-    MESH_INDEX_TEST_OBJECT,
+// The loader job and the main thread both register meshes, so lookups
+// and changes take Lock. GetMesh only reads the handle's own slot and
+// doesn't.
+struct mesh_registry {
+    u32 volatile Lock;
+    mesh_registry_cell *Cells;
+    // Per slot
+    u64 *NameHashes;
+    u32 *Generations;
+
+    u32 *FreeSlots;
+    u32 FreeSlotCount;
+    // Slots at or past this have never been handed out
+    u32 SlotCount;
+};
 
-    MESH_INDEX_MAX_COUNT
+#define MAX_MODEL_COUNT 16
+#define MAX_MODEL_MESH_COUNT 1024
+
+// A model's meshes may point straight into its mapped file, so the
+// parsed data and its mappings live as long as the model does.
+// FirstMesh indexes assets::ModelMeshes.
+struct loaded_model {
+    cgltf_data *Data;
+    u32 FirstMesh;
+    u32 MeshCount;
+    size_t BytesReferenced;
+    size_t BytesCopied;
 };
 
 struct assets {
     memory_arena VertexArena;
     memory_arena IndexArena;
+    memory_arena BVHArena;
+    // Only used inside temporary blocks while assets are built
+    memory_arena ScratchArena;
+
+    // MAX_MESH_COUNT of each in the permanent arena, indexed by
+    // registry slot
+    mesh_registry Registry;
+    mesh_object *Meshes;
+    // Only built for meshes that get picked, empty otherwise
+    mesh_bvh *BVHs;
+
+    loaded_model Models[MAX_MODEL_COUNT];
+    u32 ModelCount;
+    // Every model's meshes, in load order
+    mesh_handle ModelMeshes[MAX_MODEL_MESH_COUNT];
+    u32 ModelMeshCount;
+
+    // Mapping of the cooked asset pack, meshes loaded from it point here
+    entire_file Pack;
+};
 
-    // every mesh_object in the asset
-    // store needs an entry in mesh_index
-    mesh_object Meshes[MESH_INDEX_MAX_COUNT];
+enum upload_operation {
+    UPLOAD_OPERATION_CREATE,
+    // Frees the GPU copy and forgets the CPU one, Mesh is ignored
+    UPLOAD_OPERATION_DELETE,
 };
 
+// Meshes are identified to the renderer by registry slot. A slot is
+// only released after its delete has gone through.
 struct upload_work {
-    // TODO: figure out a good way of identifying the mesh
-    // options: Index into array, GUID into a hash table, ??
-    mesh_index Index;
+    upload_operation Operation;
+    u32 Slot;
+    // Must stay valid until deleted, the renderer re-uploads evicted
+    // meshes from it
     mesh_object *Mesh;
+    // Optional, set to true once the renderer is done with the work.
+    // Uploads are spread over frames, so this can take a while.
+    u32 volatile *Completed;
+};
+
+//
+// Upload queue
+//
+// Bounded multi-producer multi-consumer queue after Dmitry Vyukov's.
+// Every cell's Sequence says whose turn it is: its position when it's
+// free for the producer claiming that position, one past it once filled,
+// and a lap further once consumed. Producers are the loader job and the
+// main thread, the renderer consumes.
+//
+// Power of two, positions wrap around u32
+#define MAX_UPLOAD_QUEUE_COUNT (1<<8)
+struct upload_queue_cell {
+    u32 volatile Sequence;
+    upload_work Work;
+};
+
+struct upload_queue {
+    upload_queue_cell Cells[MAX_UPLOAD_QUEUE_COUNT];
+    // Padded apart, so producers and the consumer don't share a cache
+    // line
+    u32 volatile EnqueuePosition;
+    u8 EnqueuePadding[60];
+    u32 volatile DequeuePosition;
 };
 
 enum render_entry_type {
     TYPE_render_entry_line_group,
     TYPE_render_entry_quad_group,
     TYPE_render_entry_mesh,
+    TYPE_render_entry_circle_records,
+    TYPE_render_entry_circle_instances,
 };
 
 struct render_entry_header {
@@ -70,7 +260,71 @@ struct render_entry_header {
 
 struct render_entry_mesh {
     render_entry_header Header;
-    mesh_index Index;
+    u32 Slot;
+    // Clamped to the mesh's LOD count by the renderer
+    u32 LOD;
+};
+
+// GPU-resident copy of a circle. The vertex shader evaluates
+// StartPosition + Speed*(Time - SpawnTime)*Velocity, so a record only
+// changes when its circle is created, destroyed or dragged.
+struct circle_record {
+    vec4 Color;
+    vec3 StartPosition;
+    f32 SpawnTime;
+    vec3 Velocity;
+    f32 Radius;
+};
+
+// Records is the full retained array, but only the DirtyIndices get
+// uploaded. Dead records have a zero radius and collapse in the shader.
+struct render_entry_circle_records {
+    render_entry_header Header;
+
+    circle_record *Records;
+    u32 RecordCount;
+
+    u32 *DirtyIndices;
+    u32 DirtyCount;
+
+    f32 Time;
+    f32 Speed;
+    i32 HotIndex;
+};
+
+// Blended circles go through quads or retained records. Opaque circles
+// are written without blending, sorted front to back so early depth
+// testing rejects the ones hidden behind closer circles. OIT circles are
+// submitted unsorted and resolved with weighted blended transparency.
+enum circle_render_mode {
+    CIRCLE_RENDER_MODE_BLENDED,
+    CIRCLE_RENDER_MODE_OPAQUE,
+    CIRCLE_RENDER_MODE_OIT,
+
+    CIRCLE_RENDER_MODE_COUNT
+};
+
+// Drawn objects write one of these into the scene's ID attachment.
+// Circles are their index in Circles plus one, so zero stays free for
+// the background, meshes are their registry slot with the top bit set.
+#define OBJECT_ID_NONE 0
+#define OBJECT_ID_MESH_BIT 0x80000000
+#define CIRCLE_OBJECT_ID(Index) ((u32)(Index) + 1)
+#define MESH_OBJECT_ID(Slot) (OBJECT_ID_MESH_BIT | (u32)(Slot))
+
+struct circle_instance {
+    vec4 Color;
+    vec3 Position;
+    f32 Radius;
+    u32 ObjectID;
+};
+
+struct render_entry_circle_instances {
+    render_entry_header Header;
+
+    circle_render_mode Mode;
+    circle_instance *Instances;
+    u32 InstanceCount;
 };
 
 struct render_entry_line_group {
@@ -81,60 +335,89 @@ struct render_entry_line_group {
 
     u16 *Indices;
     u32 IndexCount;
-    size_t IndexOffset;
+    u32 FirstIndex;
+    u32 BaseVertex;
 };
 
+// Quads don't carry indices. The renderer owns a static index
+// buffer with the repeating 0,1,2,2,3,0 pattern and draws each
+// group against it with BaseVertex.
 struct render_entry_quad_group {
     render_entry_header Header;
 
     vertex *Vertices;
+    u32 *ObjectIDs;
     u32 VertexCount;
-
-    u16 *Indices;
-    u32 IndexCount;
-    size_t IndexOffset;
+    u32 BaseVertex;
 };
 
+// BaseVertex/FirstIndex are where Vertices/Indices start in the
+// renderer's push buffers. They're zero for the top level commands
+// and point at the reserved chunk for sub-commands.
+// Quad vertices carry their object ID in the parallel ObjectIDs
+// array, so vertex stays the same layout as static meshes.
 struct vertex_group {
     vertex *Vertices;
+    u32 *ObjectIDs;
     u32 VertexCount;
     u32 MaxVertexCount;
-
-    u16 *Indices;
-    u32 IndexCount;
-    u32 MaxIndexCount;
+    u32 BaseVertex;
 };
 
 struct line_vertex_group {
     line_vertex *Vertices;
     u32 VertexCount;
     u32 MaxVertexCount;
+    u32 BaseVertex;
 
     u16 *Indices;
     u32 IndexCount;
     u32 MaxIndexCount;
+    u32 FirstIndex;
 };
 
+#define DEFAULT_MSAA_SAMPLE_COUNT 4
+// Below the renderer's static geometry capacity, so eviction is exercised
+#define DEFAULT_MESH_BUDGET_BYTES (8*MiB)
+#define SUB_COMMANDS_QUAD_CHUNK_VERTEX_COUNT (1<<12)
+#define SUB_COMMANDS_LINE_CHUNK_VERTEX_COUNT (1<<10)
 struct render_commands {
     line_vertex_group LineGroup;
     vertex_group QuadGroup;
 
-    upload_work *UploadQueue;
-    u32 UploadQueueCount;
-    u32 MaxUploadQueueCount;
+    // Owned by the renderer and lives as long as it, so jobs may keep
+    // the pointer
+    upload_queue *UploadQueue;
 
-    render_entry_header *Entries;
+    u8 *Entries;
     size_t RenderEntrySize;
     size_t MaxRenderEntrySize;
 
     render_entry_line_group *CurrentLines;
     render_entry_quad_group *CurrentQuads;
 
+    // Sub-commands let worker jobs record geometry in parallel. Each
+    // one bump allocates vertex chunks from its Parent's push buffers
+    // and keeps its own entries until MergeSubCommands appends them.
+    render_commands *Parent;
+    render_commands *SubCommands;
+    u32 MaxSubCommandCount;
+
     assets *Assets;
     camera *Camera;
     vec3 WorldUp;
 
     u32 CircleCount;
+
+    // Requested MSAA sample count for the scene target, 0 keeps the current one
+    u32 SampleCount;
+
+    // Requested GPU budget for static meshes in bytes, 0 keeps the current one
+    size_t MeshBudgetBytes;
+
+    // Object ID under the mouse from the latest finished readback of
+    // the ID attachment, normally last frame's. Set by the renderer.
+    u32 PickedObjectID;
 };
 
 struct bounding_box {
@@ -164,10 +447,42 @@ struct circle_object {
     circle_object *Prev;
 };
 
+enum terrain_chunk_state {
+    TERRAIN_CHUNK_FREE,
+    // Owned by a worker until it sets GENERATED
+    TERRAIN_CHUNK_GENERATING,
+    TERRAIN_CHUNK_GENERATED,
+    // Queued for upload, resident once the renderer completes it
+    TERRAIN_CHUNK_UPLOADING,
+    TERRAIN_CHUNK_RESIDENT,
+    // The delete is queued, the slot is free once it completes
+    TERRAIN_CHUNK_RETIRED,
+};
+
+struct terrain_chunk {
+    u32 volatile State;
+    i32 X;
+    i32 Y;
+    // Registered under the chunk's coordinates while it's in use
+    mesh_handle Handle;
+    // Completion flag for the upload or delete in flight
+    u32 volatile UploadCompleted;
+    // Points into the slot's own storage, the renderer re-uploads
+    // evicted chunks from it
+    mesh_object Mesh;
+};
+
+struct terrain {
+    terrain_chunk Chunks[MAX_TERRAIN_CHUNK_COUNT];
+};
+
+#define CIRCLE_SPEED 0.25f
+#define CAMERA_PAN_SPEED 8.f
 #define MAX_CIRCLE_COUNT (1<<16)
 struct program_state {
     memory_arena PermanentArena;
 
+    mesh_handle TestObject;
     bounding_box TestBox;
 
     circle_object Circles[MAX_CIRCLE_COUNT];
@@ -176,6 +491,69 @@ struct program_state {
     circle_object *FirstFreeCircle;
     circle_object *HotCircle;
 
+    // Retained mode keeps every circle resident on the GPU, indexed
+    // the same as Circles, and reuploads only the dirty records.
+    b32 RetainedCircles;
+    f64 Time;
+    circle_record CircleRecords[MAX_CIRCLE_COUNT];
+    u32 CircleRecordCount;
+    b8 CircleRecordDirty[MAX_CIRCLE_COUNT];
+    u32 DirtyCircleIndices[MAX_CIRCLE_COUNT];
+    u32 DirtyCircleCount;
+
+    // Per frame instances for the non-blended modes. Jobs write them in
+    // list order, opaque mode then sorts them into SortedCircleInstances.
+    circle_render_mode CircleRenderMode;
+    circle_instance CircleInstances[MAX_CIRCLE_COUNT];
+    circle_instance SortedCircleInstances[MAX_CIRCLE_COUNT];
+    sort_entry CircleSortEntries[MAX_CIRCLE_COUNT];
+    sort_entry CircleSortTemp[MAX_CIRCLE_COUNT];
+
+    // Where the dragged circle's geometry ended up this frame, for
+    // LateLatchDrag to patch
+    circle_object *DraggedCircle;
+    vertex *DraggedVertices;
+    circle_instance *DraggedInstance;
+
+    u32 SampleCount;
+    size_t MeshBudgetBytes;
+
+    // Picks from the renderer's object IDs instead of the CPU tests
+    b32 GPUPicking;
+
     assets Assets;
+    // Filled in by the loader job as meshes are loaded, for LOD
+    // selection. Terrain chunks are left zero.
+    bounding_box MeshBounds[MAX_MESH_COUNT];
+    // How many of Assets.ModelMeshes the loader job has finished and
+    // queued for upload. Only these are touched by the main thread.
+    u32 volatile LoadedModelMeshCount;
+    upload_queue *UploadQueue;
     camera Camera;
+
+    terrain Terrain;
 };
+
+struct circle_update_job {
+    render_commands *Commands;
+    // Base of State->Circles, for object IDs
+    circle_object *Circles;
+    circle_object *First;
+    u32 Count;
+
+    // When Instances is set the job writes instances instead of quads.
+    // Retained circles are already moved analytically and don't integrate.
+    circle_instance *Instances;
+    b32 Integrate;
+
+    circle_object *HotCircle;
+    circle_object *DraggedCircle;
+    f32 dt;
+
+    // Set by the job that emits the dragged circle
+    vertex *DraggedVertices;
+    circle_instance *DraggedInstance;
+};
+
+#define MAX_CIRCLE_JOB_COUNT 16
+#define MIN_CIRCLES_PER_JOB 1024
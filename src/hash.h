@@ -0,0 +1,25 @@
+#pragma once
+
+// 64-bit FNV-1a. Pass a previous result as Hash to chain several buffers
+// into one key.
+#define FNV1A_64_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV1A_64_PRIME 0x100000001b3ull
+
+static inline u64 HashFNV1a(const void *Data, size_t Size, u64 Hash = FNV1A_64_OFFSET_BASIS) {
+    const u8 *Bytes = (const u8 *)Data;
+    for (size_t i = 0; i < Size; ++i) {
+        Hash ^= Bytes[i];
+        Hash *= FNV1A_64_PRIME;
+    }
+    return Hash;
+}
+
+static inline u64 HashString(const char *String, u64 Hash = FNV1A_64_OFFSET_BASIS) {
+    if (String) {
+        while (*String) {
+            Hash ^= (u8)*String++;
+            Hash *= FNV1A_64_PRIME;
+        }
+    }
+    return Hash;
+}
@@ -10,6 +10,14 @@ enum button_type {
     BUTTON_KEY_S,
     BUTTON_KEY_D,
 
+    BUTTON_KEY_R,
+    BUTTON_KEY_M,
+    BUTTON_KEY_O,
+    BUTTON_KEY_V,
+    BUTTON_KEY_L,
+    BUTTON_KEY_F,
+    BUTTON_KEY_G,
+
     BUTTON_KEY_LEFT,
     BUTTON_KEY_RIGHT,
     BUTTON_KEY_UP,
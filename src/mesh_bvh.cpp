@@ -0,0 +1,414 @@
+#pragma once
+
+//
+// Mesh BVH
+//
+// Built top down with binned SAH: each node's triangles are binned by
+// centroid along every axis and split where the surface area heuristic
+// is cheapest, or kept as a leaf when that beats any split. Nodes come
+// out depth first with skip indices, so traversal is one loop without a
+// stack. Leaf triangles are stored as edges in blocks of four and hit
+// tested four at a time with SSE Moller-Trumbore.
+//
+#define BVH_BIN_COUNT 16
+#define BVH_MAX_LEAF_TRIANGLE_COUNT 8
+// Relative to testing one block of triangles
+#define BVH_TRAVERSAL_COST 0.25f
+// Past this depth nodes are split at the median, which bounds the
+// recursion on degenerate input
+#define BVH_MAX_DEPTH 64
+#define BVH_MIN_DETERMINANT 1e-12f
+#define BVH_MIN_DIRECTION 1e-20f
+
+struct bvh_bin {
+    vec3 Min;
+    vec3 Max;
+    u32 Count;
+};
+
+struct bvh_builder {
+    vec3 *Min;
+    vec3 *Max;
+    vec3 *Centroids;
+    u32 *Triangles;
+
+    bvh_node *Nodes;
+    u32 NodeCount;
+    u32 MaxNodeCount;
+};
+
+static inline vec3 MinVec3(vec3 A, vec3 B) {
+    return vec3((A.x < B.x) ? A.x : B.x, (A.y < B.y) ? A.y : B.y, (A.z < B.z) ? A.z : B.z);
+}
+
+static inline vec3 MaxVec3(vec3 A, vec3 B) {
+    return vec3((A.x > B.x) ? A.x : B.x, (A.y > B.y) ? A.y : B.y, (A.z > B.z) ? A.z : B.z);
+}
+
+// Half the surface area, SAH only compares ratios
+static inline f32 GetBoxArea(vec3 Min, vec3 Max) {
+    vec3 d = Max - Min;
+    return d.x*d.y + d.y*d.z + d.z*d.x;
+}
+
+// Triangles are tested a block at a time, so costs are counted in blocks
+static inline u32 GetBlockCount(u32 TriangleCount) {
+    return (TriangleCount + 3)/4;
+}
+
+static inline u32 GetBVHBin(f32 Centroid, f32 Min, f32 Scale) {
+    i32 Result = (i32)((Centroid - Min)*Scale);
+    Result = (Result < 0) ? 0 : ((Result >= BVH_BIN_COUNT) ? BVH_BIN_COUNT - 1 : Result);
+    return (u32)Result;
+}
+
+// Appends the node for Triangles[First, First + Count) and its subtree
+static void BuildBVHNode(bvh_builder *Builder, u32 First, u32 Count, u32 Depth) {
+    Assert(Count > 0 && Builder->NodeCount < Builder->MaxNodeCount);
+    u32 NodeIndex = Builder->NodeCount++;
+    bvh_node *Node = Builder->Nodes + NodeIndex;
+
+    vec3 Min = vec3(FLT_MAX);
+    vec3 Max = vec3(-FLT_MAX);
+    vec3 CentroidMin = vec3(FLT_MAX);
+    vec3 CentroidMax = vec3(-FLT_MAX);
+    for (u32 i = First; i < First + Count; ++i) {
+        u32 Triangle = Builder->Triangles[i];
+        Min = MinVec3(Min, Builder->Min[Triangle]);
+        Max = MaxVec3(Max, Builder->Max[Triangle]);
+        CentroidMin = MinVec3(CentroidMin, Builder->Centroids[Triangle]);
+        CentroidMax = MaxVec3(CentroidMax, Builder->Centroids[Triangle]);
+    }
+    Node->Min = Min;
+    Node->Max = Max;
+    Node->Leaf = 0;
+
+    f32 BestCost = FLT_MAX;
+    u32 BestAxis = 0;
+    u32 BestSplit = 0;
+    for (u32 Axis = 0; Axis < 3 && Count > 1; ++Axis) {
+        f32 Extent = CentroidMax.Elements[Axis] - CentroidMin.Elements[Axis];
+        if (!(Extent > 0.f)) {
+            continue;
+        }
+        f32 Scale = BVH_BIN_COUNT/Extent;
+
+        bvh_bin Bins[BVH_BIN_COUNT];
+        for (u32 b = 0; b < BVH_BIN_COUNT; ++b) {
+            Bins[b].Min = vec3(FLT_MAX);
+            Bins[b].Max = vec3(-FLT_MAX);
+            Bins[b].Count = 0;
+        }
+        for (u32 i = First; i < First + Count; ++i) {
+            u32 Triangle = Builder->Triangles[i];
+            bvh_bin *Bin = Bins + GetBVHBin(Builder->Centroids[Triangle].Elements[Axis], CentroidMin.Elements[Axis], Scale);
+            Bin->Min = MinVec3(Bin->Min, Builder->Min[Triangle]);
+            Bin->Max = MaxVec3(Bin->Max, Builder->Max[Triangle]);
+            ++Bin->Count;
+        }
+
+        // Right side costs for every split plane, then sweep from the left
+        f32 RightCosts[BVH_BIN_COUNT];
+        vec3 SideMin = vec3(FLT_MAX);
+        vec3 SideMax = vec3(-FLT_MAX);
+        u32 SideCount = 0;
+        for (u32 b = BVH_BIN_COUNT - 1; b > 0; --b) {
+            SideMin = MinVec3(SideMin, Bins[b].Min);
+            SideMax = MaxVec3(SideMax, Bins[b].Max);
+            SideCount += Bins[b].Count;
+            RightCosts[b] = SideCount ? GetBlockCount(SideCount)*GetBoxArea(SideMin, SideMax) : 0.f;
+        }
+
+        SideMin = vec3(FLT_MAX);
+        SideMax = vec3(-FLT_MAX);
+        SideCount = 0;
+        for (u32 Split = 1; Split < BVH_BIN_COUNT; ++Split) {
+            SideMin = MinVec3(SideMin, Bins[Split - 1].Min);
+            SideMax = MaxVec3(SideMax, Bins[Split - 1].Max);
+            SideCount += Bins[Split - 1].Count;
+            if (SideCount == 0 || SideCount == Count) {
+                continue;
+            }
+            f32 Cost = GetBlockCount(SideCount)*GetBoxArea(SideMin, SideMax) + RightCosts[Split];
+            if (Cost < BestCost) {
+                BestCost = Cost;
+                BestAxis = Axis;
+                BestSplit = Split;
+            }
+        }
+    }
+
+    f32 Area = GetBoxArea(Min, Max);
+    f32 SplitCost = (Area > 0.f) ? BVH_TRAVERSAL_COST + BestCost/Area : BVH_TRAVERSAL_COST;
+    b32 KeepLeaf = (Count <= BVH_MAX_LEAF_TRIANGLE_COUNT && (BestCost == FLT_MAX || (f32)GetBlockCount(Count) <= SplitCost));
+    if (KeepLeaf) {
+        // The block is filled in once the tree is done, nonzero marks it
+        // as a leaf until then
+        Node->Leaf = Count;
+        Node->MissIndex = NodeIndex + 1;
+        return;
+    }
+
+    // All centroids in one spot or too deep, any split will do
+    u32 Middle = First + Count/2;
+    if (BestCost != FLT_MAX && Depth < BVH_MAX_DEPTH) {
+        f32 AxisMin = CentroidMin.Elements[BestAxis];
+        f32 Scale = BVH_BIN_COUNT/(CentroidMax.Elements[BestAxis] - AxisMin);
+        // Right is one past the last unsorted triangle, so it never goes
+        // below First
+        u32 *Triangles = Builder->Triangles;
+        u32 Left = First;
+        u32 Right = First + Count;
+        while (Left < Right) {
+            if (GetBVHBin(Builder->Centroids[Triangles[Left]].Elements[BestAxis], AxisMin, Scale) < BestSplit) {
+                ++Left;
+            }
+            else {
+                --Right;
+                u32 Swap = Triangles[Left];
+                Triangles[Left] = Triangles[Right];
+                Triangles[Right] = Swap;
+            }
+        }
+        if (Left > First && Left < First + Count) {
+            Middle = Left;
+        }
+    }
+
+    BuildBVHNode(Builder, First, Middle - First, Depth + 1);
+    BuildBVHNode(Builder, Middle, First + Count - Middle, Depth + 1);
+    Builder->Nodes[NodeIndex].MissIndex = Builder->NodeCount;
+}
+
+static void BuildMeshBVH(memory_arena *BVHArena, memory_arena *Scratch, mesh_object *Mesh, mesh_bvh *BVH, const char *Name) {
+    *BVH = {};
+    Assert(Mesh->LODCount > 0);
+    mesh_lod *LOD = Mesh->LODs;
+
+    u32 TriangleCount = 0;
+    for (u32 p = LOD->FirstPart; p < LOD->FirstPart + LOD->PartCount; ++p) {
+        TriangleCount += Mesh->Parts[p].IndexCount/3;
+    }
+    if (!TriangleCount) {
+        return;
+    }
+
+    temporary_memory Temp = BeginTemporaryMemory(Scratch);
+    bvh_builder Builder = {};
+    Builder.Min = PushArray(Scratch, vec3, TriangleCount);
+    Builder.Max = PushArray(Scratch, vec3, TriangleCount);
+    Builder.Centroids = PushArray(Scratch, vec3, TriangleCount);
+    Builder.Triangles = PushArray(Scratch, u32, TriangleCount);
+    Builder.MaxNodeCount = 2*TriangleCount - 1;
+    Builder.Nodes = PushArray(Scratch, bvh_node, Builder.MaxNodeCount);
+    // Corners are gathered once so the block fill doesn't walk the parts again
+    vec3 *Corners = PushArray(Scratch, vec3, 3*TriangleCount);
+    if (!Builder.Min || !Builder.Max || !Builder.Centroids || !Builder.Triangles || !Builder.Nodes || !Corners) {
+        LWARN("Scratch arena full, %s has no BVH.", Name);
+        EndTemporaryMemory(Temp);
+        return;
+    }
+
+    u32 Triangle = 0;
+    for (u32 p = LOD->FirstPart; p < LOD->FirstPart + LOD->PartCount; ++p) {
+        mesh_part *Part = Mesh->Parts + p;
+        u16 *Indices = Mesh->Indices + Part->FirstIndex;
+        vertex *Vertices = Mesh->Vertices + Part->BaseVertex;
+        for (u32 i = 0; i + 2 < Part->IndexCount; i += 3, ++Triangle) {
+            vec3 A = Vertices[Indices[i + 0]].Position;
+            vec3 B = Vertices[Indices[i + 1]].Position;
+            vec3 C = Vertices[Indices[i + 2]].Position;
+            Corners[3*Triangle + 0] = A;
+            Corners[3*Triangle + 1] = B;
+            Corners[3*Triangle + 2] = C;
+            Builder.Min[Triangle] = MinVec3(A, MinVec3(B, C));
+            Builder.Max[Triangle] = MaxVec3(A, MaxVec3(B, C));
+            Builder.Centroids[Triangle] = (A + B + C)/3.f;
+            Builder.Triangles[Triangle] = Triangle;
+        }
+    }
+
+    BuildBVHNode(&Builder, 0, TriangleCount, 0);
+
+    u32 BlockCount = 0;
+    for (u32 i = 0; i < Builder.NodeCount; ++i) {
+        BlockCount += GetBlockCount(Builder.Nodes[i].Leaf);
+    }
+
+    BVH->Nodes = PushArray(BVHArena, bvh_node, Builder.NodeCount);
+    BVH->Blocks = PushArray(BVHArena, bvh_triangle_block, BlockCount);
+    if (!BVH->Nodes || !BVH->Blocks) {
+        LWARN("BVH arena full, %s has no BVH.", Name);
+        *BVH = {};
+        EndTemporaryMemory(Temp);
+        return;
+    }
+
+    // Leaves are in the same order as their triangle ranges, so the
+    // blocks are filled walking both together
+    u32 NextTriangle = 0;
+    for (u32 i = 0; i < Builder.NodeCount; ++i) {
+        bvh_node *Node = Builder.Nodes + i;
+        u32 LeafTriangleCount = Node->Leaf;
+        if (!LeafTriangleCount) {
+            continue;
+        }
+        Assert(LeafTriangleCount <= BVH_LEAF_TRIANGLE_COUNT_MASK);
+        Node->Leaf = (BVH->BlockCount << BVH_LEAF_TRIANGLE_COUNT_BITS) | LeafTriangleCount;
+
+        for (u32 j = 0; j < LeafTriangleCount; j += 4) {
+            bvh_triangle_block *Block = BVH->Blocks + BVH->BlockCount++;
+            *Block = {};
+            for (u32 Lane = 0; Lane < 4; ++Lane) {
+                if (j + Lane >= LeafTriangleCount) {
+                    Block->Triangles[Lane] = UINT32_MAX;
+                    continue;
+                }
+                u32 Source = Builder.Triangles[NextTriangle++];
+                vec3 *P = Corners + 3*Source;
+                vec3 Edge1 = P[1] - P[0];
+                vec3 Edge2 = P[2] - P[0];
+                for (u32 Axis = 0; Axis < 3; ++Axis) {
+                    Block->V0[Axis][Lane] = P[0].Elements[Axis];
+                    Block->Edge1[Axis][Lane] = Edge1.Elements[Axis];
+                    Block->Edge2[Axis][Lane] = Edge2.Elements[Axis];
+                }
+                Block->Triangles[Lane] = Source;
+            }
+        }
+    }
+    Assert(NextTriangle == TriangleCount && BVH->BlockCount == BlockCount);
+
+    memcpy(BVH->Nodes, Builder.Nodes, Builder.NodeCount*sizeof(bvh_node));
+    BVH->NodeCount = Builder.NodeCount;
+    EndTemporaryMemory(Temp);
+
+    LINFO("Built BVH for %s: %u triangles, %u nodes, %u blocks.", Name, TriangleCount, BVH->NodeCount, BVH->BlockCount);
+}
+
+//
+// Traversal
+//
+struct bvh_ray {
+    __m128 Origin;
+    __m128 InverseDirection;
+    __m128 Origin4[3];
+    __m128 Direction4[3];
+};
+
+// Slab test on x, y and z at once. The fourth lane loads the node's
+// index fields and is never read back.
+static inline b32 RayHitsBox(bvh_ray *Ray, bvh_node *Node, f32 MaxT) {
+    __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&Node->Min.x), Ray->Origin), Ray->InverseDirection);
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&Node->Max.x), Ray->Origin), Ray->InverseDirection);
+    __m128 Near = _mm_min_ps(t0, t1);
+    __m128 Far = _mm_max_ps(t0, t1);
+    Near = _mm_max_ss(_mm_max_ss(Near, _mm_shuffle_ps(Near, Near, _MM_SHUFFLE(1, 1, 1, 1))), _mm_shuffle_ps(Near, Near, _MM_SHUFFLE(2, 2, 2, 2)));
+    Far = _mm_min_ss(_mm_min_ss(Far, _mm_shuffle_ps(Far, Far, _MM_SHUFFLE(1, 1, 1, 1))), _mm_shuffle_ps(Far, Far, _MM_SHUFFLE(2, 2, 2, 2)));
+    Near = _mm_max_ss(Near, _mm_setzero_ps());
+    Far = _mm_min_ss(Far, _mm_set_ss(MaxT));
+    return _mm_comile_ss(Near, Far);
+}
+
+// Moller-Trumbore on all four lanes, returns the lanes hit closer than
+// MaxT as a bitmask with their distances in t
+static inline u32 IntersectTriangleBlock(bvh_ray *Ray, bvh_triangle_block *Block, f32 MaxT, f32 *t) {
+    __m128 E1x = _mm_loadu_ps(Block->Edge1[0]);
+    __m128 E1y = _mm_loadu_ps(Block->Edge1[1]);
+    __m128 E1z = _mm_loadu_ps(Block->Edge1[2]);
+    __m128 E2x = _mm_loadu_ps(Block->Edge2[0]);
+    __m128 E2y = _mm_loadu_ps(Block->Edge2[1]);
+    __m128 E2z = _mm_loadu_ps(Block->Edge2[2]);
+    __m128 Dx = Ray->Direction4[0];
+    __m128 Dy = Ray->Direction4[1];
+    __m128 Dz = Ray->Direction4[2];
+
+    // P = D x E2
+    __m128 Px = _mm_sub_ps(_mm_mul_ps(Dy, E2z), _mm_mul_ps(Dz, E2y));
+    __m128 Py = _mm_sub_ps(_mm_mul_ps(Dz, E2x), _mm_mul_ps(Dx, E2z));
+    __m128 Pz = _mm_sub_ps(_mm_mul_ps(Dx, E2y), _mm_mul_ps(Dy, E2x));
+    __m128 Determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(E1x, Px), _mm_mul_ps(E1y, Py)), _mm_mul_ps(E1z, Pz));
+    __m128 InverseDeterminant = _mm_div_ps(_mm_set1_ps(1.f), Determinant);
+
+    // T = O - V0
+    __m128 Tx = _mm_sub_ps(Ray->Origin4[0], _mm_loadu_ps(Block->V0[0]));
+    __m128 Ty = _mm_sub_ps(Ray->Origin4[1], _mm_loadu_ps(Block->V0[1]));
+    __m128 Tz = _mm_sub_ps(Ray->Origin4[2], _mm_loadu_ps(Block->V0[2]));
+    __m128 U = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Tx, Px), _mm_mul_ps(Ty, Py)), _mm_mul_ps(Tz, Pz)), InverseDeterminant);
+
+    // Q = T x E1
+    __m128 Qx = _mm_sub_ps(_mm_mul_ps(Ty, E1z), _mm_mul_ps(Tz, E1y));
+    __m128 Qy = _mm_sub_ps(_mm_mul_ps(Tz, E1x), _mm_mul_ps(Tx, E1z));
+    __m128 Qz = _mm_sub_ps(_mm_mul_ps(Tx, E1y), _mm_mul_ps(Ty, E1x));
+    __m128 V = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(Dx, Qx), _mm_mul_ps(Dy, Qy)), _mm_mul_ps(Dz, Qz)), InverseDeterminant);
+    __m128 Distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(E2x, Qx), _mm_mul_ps(E2y, Qy)), _mm_mul_ps(E2z, Qz)), InverseDeterminant);
+
+    // Both faces count, picking shouldn't care about winding. Padding
+    // lanes fail the determinant test, and NaNs fail every compare.
+    __m128 Zero = _mm_setzero_ps();
+    __m128 AbsDeterminant = _mm_andnot_ps(_mm_set1_ps(-0.f), Determinant);
+    __m128 Mask = _mm_cmpgt_ps(AbsDeterminant, _mm_set1_ps(BVH_MIN_DETERMINANT));
+    Mask = _mm_and_ps(Mask, _mm_cmpge_ps(U, Zero));
+    Mask = _mm_and_ps(Mask, _mm_cmpge_ps(V, Zero));
+    Mask = _mm_and_ps(Mask, _mm_cmple_ps(_mm_add_ps(U, V), _mm_set1_ps(1.f)));
+    Mask = _mm_and_ps(Mask, _mm_cmpgt_ps(Distance, Zero));
+    Mask = _mm_and_ps(Mask, _mm_cmplt_ps(Distance, _mm_set1_ps(MaxT)));
+
+    _mm_storeu_ps(t, Distance);
+    return (u32)_mm_movemask_ps(Mask);
+}
+
+// Closest hit along Origin + t*Direction with t in (0, MaxT)
+static b32 RaycastMeshBVH(mesh_bvh *BVH, vec3 Origin, vec3 Direction, f32 MaxT, bvh_hit *Hit) {
+    // Zero components are nudged off zero. An infinite inverse times a
+    // zero distance is a NaN, which would throw out boxes an axis aligned
+    // ray runs along the face of.
+    f32 InverseDirection[3];
+    for (u32 Axis = 0; Axis < 3; ++Axis) {
+        f32 d = Direction.Elements[Axis];
+        if (fabsf(d) < BVH_MIN_DIRECTION) {
+            d = (d < 0.f) ? -BVH_MIN_DIRECTION : BVH_MIN_DIRECTION;
+        }
+        InverseDirection[Axis] = 1.f/d;
+    }
+
+    bvh_ray Ray;
+    Ray.Origin = _mm_setr_ps(Origin.x, Origin.y, Origin.z, 0.f);
+    Ray.InverseDirection = _mm_setr_ps(InverseDirection[0], InverseDirection[1], InverseDirection[2], 0.f);
+    for (u32 Axis = 0; Axis < 3; ++Axis) {
+        Ray.Origin4[Axis] = _mm_set1_ps(Origin.Elements[Axis]);
+        Ray.Direction4[Axis] = _mm_set1_ps(Direction.Elements[Axis]);
+    }
+
+    b32 Result = false;
+    f32 ClosestT = MaxT;
+    u32 NodeIndex = 0;
+    while (NodeIndex < BVH->NodeCount) {
+        bvh_node *Node = BVH->Nodes + NodeIndex;
+        if (!RayHitsBox(&Ray, Node, ClosestT)) {
+            NodeIndex = Node->MissIndex;
+            continue;
+        }
+        if (!Node->Leaf) {
+            ++NodeIndex;
+            continue;
+        }
+
+        u32 TriangleCount = Node->Leaf & BVH_LEAF_TRIANGLE_COUNT_MASK;
+        bvh_triangle_block *Block = BVH->Blocks + (Node->Leaf >> BVH_LEAF_TRIANGLE_COUNT_BITS);
+        for (u32 i = 0; i < TriangleCount; i += 4, ++Block) {
+            f32 t[4];
+            u32 LaneMask = IntersectTriangleBlock(&Ray, Block, ClosestT, t);
+            for (u32 Lane = 0; LaneMask; ++Lane, LaneMask >>= 1) {
+                if ((LaneMask & 1) && t[Lane] < ClosestT) {
+                    ClosestT = t[Lane];
+                    Hit->t = t[Lane];
+                    Hit->Triangle = Block->Triangles[Lane];
+                    Result = true;
+                }
+            }
+        }
+        NodeIndex = Node->MissIndex;
+    }
+    return Result;
+}
@@ -0,0 +1,371 @@
+#pragma once
+
+//
+// Mesh optimizer
+//
+// Runs on meshes whose vertices and indices are writable, in three steps:
+// triangles are reordered for the post-transform vertex cache (Forsyth's
+// linear-speed algorithm), the resulting cache-friendly clusters are
+// optionally ordered outside-in to cut overdraw, and vertices are
+// renumbered in first-use order so fetches walk memory forwards. Scratch
+// memory comes from a temporary block on the given arena.
+//
+#define VERTEX_CACHE_SIZE 32
+#define VERTEX_CACHE_DECAY_POWER 1.5f
+#define VERTEX_CACHE_LAST_TRIANGLE_SCORE 0.75f
+#define VERTEX_VALENCE_BOOST_SCALE 2.f
+#define VERTEX_VALENCE_BOOST_POWER 0.5f
+// Analysis models a FIFO cache, closer to what GPUs actually have
+#define VERTEX_CACHE_ANALYSIS_SIZE 16
+
+struct vertex_cache_stats {
+    // Average cache miss ratio, transformed vertices per triangle. 0.5 is
+    // the ideal for a big regular grid, 3 means nothing is reused.
+    f32 ACMR;
+    // Average transform to vertex ratio, 1 means each vertex is
+    // transformed exactly once
+    f32 ATVR;
+};
+
+static vertex_cache_stats AnalyzeVertexCache(memory_arena *Scratch, u16 *Indices, u32 IndexCount, u32 VertexCount) {
+    vertex_cache_stats Result = {};
+    if (IndexCount < 3 || VertexCount == 0) {
+        return Result;
+    }
+
+    temporary_memory Temp = BeginTemporaryMemory(Scratch);
+    u32 *CacheTimestamps = PushArray(Scratch, u32, VertexCount);
+    if (!CacheTimestamps) {
+        EndTemporaryMemory(Temp);
+        return Result;
+    }
+    memset(CacheTimestamps, 0, VertexCount*sizeof(u32));
+
+    // A vertex is cached if it missed within the last cache size misses
+    u32 Timestamp = VERTEX_CACHE_ANALYSIS_SIZE + 1;
+    u32 Misses = 0;
+    u32 UsedVertexCount = 0;
+    for (u32 i = 0; i < IndexCount; ++i) {
+        u32 Index = Indices[i];
+        if (CacheTimestamps[Index] == 0) {
+            ++UsedVertexCount;
+        }
+        if (Timestamp - CacheTimestamps[Index] > VERTEX_CACHE_ANALYSIS_SIZE) {
+            CacheTimestamps[Index] = Timestamp++;
+            ++Misses;
+        }
+    }
+    EndTemporaryMemory(Temp);
+
+    Result.ACMR = (f32)Misses/(IndexCount/3);
+    Result.ATVR = (f32)Misses/UsedVertexCount;
+    return Result;
+}
+
+static inline f32 GetVertexScore(i32 CachePosition, u32 ActiveTriangleCount) {
+    if (ActiveTriangleCount == 0) {
+        // Nothing left to draw with it
+        return -1.f;
+    }
+
+    f32 Score = 0.f;
+    if (CachePosition >= 0) {
+        if (CachePosition < 3) {
+            // Fixed score for the last triangle's vertices, so the next
+            // triangle doesn't strongly prefer reusing its edge
+            Score = VERTEX_CACHE_LAST_TRIANGLE_SCORE;
+        }
+        else {
+            f32 Scale = 1.f/(VERTEX_CACHE_SIZE - 3);
+            Score = powf(1.f - (CachePosition - 3)*Scale, VERTEX_CACHE_DECAY_POWER);
+        }
+    }
+    // Finishing off vertices with few triangles left stops them from
+    // being stranded and transformed again much later
+    Score += VERTEX_VALENCE_BOOST_SCALE*powf((f32)ActiveTriangleCount, -VERTEX_VALENCE_BOOST_POWER);
+    return Score;
+}
+
+// Returns false if the scratch arena is full, the indices are left as they were
+static b32 OptimizeVertexCache(memory_arena *Scratch, u16 *Indices, u32 IndexCount, u32 VertexCount) {
+    u32 TriangleCount = IndexCount/3;
+    if (TriangleCount == 0) {
+        return true;
+    }
+
+    temporary_memory Temp = BeginTemporaryMemory(Scratch);
+    u32 *ActiveTriangleCounts = PushArray(Scratch, u32, VertexCount);
+    u32 *AdjacencyOffsets = PushArray(Scratch, u32, VertexCount);
+    u32 *Adjacency = PushArray(Scratch, u32, IndexCount);
+    i32 *CachePositions = PushArray(Scratch, i32, VertexCount);
+    f32 *VertexScores = PushArray(Scratch, f32, VertexCount);
+    f32 *TriangleScores = PushArray(Scratch, f32, TriangleCount);
+    b8 *Emitted = PushArray(Scratch, b8, TriangleCount);
+    u16 *Output = PushArray(Scratch, u16, IndexCount);
+    if (!ActiveTriangleCounts || !AdjacencyOffsets || !Adjacency || !CachePositions ||
+            !VertexScores || !TriangleScores || !Emitted || !Output) {
+        EndTemporaryMemory(Temp);
+        return false;
+    }
+
+    // Triangles of each vertex, packed in one array
+    memset(ActiveTriangleCounts, 0, VertexCount*sizeof(u32));
+    for (u32 i = 0; i < IndexCount; ++i) {
+        ++ActiveTriangleCounts[Indices[i]];
+    }
+    u32 Offset = 0;
+    for (u32 i = 0; i < VertexCount; ++i) {
+        AdjacencyOffsets[i] = Offset;
+        Offset += ActiveTriangleCounts[i];
+        ActiveTriangleCounts[i] = 0;
+    }
+    for (u32 Triangle = 0; Triangle < TriangleCount; ++Triangle) {
+        for (u32 k = 0; k < 3; ++k) {
+            u32 Vertex = Indices[3*Triangle + k];
+            Adjacency[AdjacencyOffsets[Vertex] + ActiveTriangleCounts[Vertex]++] = Triangle;
+        }
+    }
+
+    for (u32 i = 0; i < VertexCount; ++i) {
+        CachePositions[i] = -1;
+        VertexScores[i] = GetVertexScore(-1, ActiveTriangleCounts[i]);
+    }
+    u32 BestTriangle = 0;
+    f32 BestScore = -1.f;
+    for (u32 Triangle = 0; Triangle < TriangleCount; ++Triangle) {
+        Emitted[Triangle] = false;
+        TriangleScores[Triangle] = VertexScores[Indices[3*Triangle + 0]] +
+            VertexScores[Indices[3*Triangle + 1]] + VertexScores[Indices[3*Triangle + 2]];
+        if (TriangleScores[Triangle] > BestScore) {
+            BestScore = TriangleScores[Triangle];
+            BestTriangle = Triangle;
+        }
+    }
+
+    // Holds three extra entries so vertices pushed out this step still get
+    // their scores lowered
+    u32 Cache[VERTEX_CACHE_SIZE + 3];
+    u32 CacheCount = 0;
+    u32 ScanCursor = 0;
+    for (u32 EmittedCount = 0; EmittedCount < TriangleCount; ++EmittedCount) {
+        if (BestScore < 0.f) {
+            // Nothing in the cache touches an unemitted triangle, resume
+            // the scan where it last stopped, every triangle before it is done
+            while (Emitted[ScanCursor]) {
+                ++ScanCursor;
+            }
+            BestTriangle = ScanCursor;
+        }
+
+        u16 *Corners = Indices + 3*BestTriangle;
+        Output[3*EmittedCount + 0] = Corners[0];
+        Output[3*EmittedCount + 1] = Corners[1];
+        Output[3*EmittedCount + 2] = Corners[2];
+        Emitted[BestTriangle] = true;
+
+        u32 NewCache[VERTEX_CACHE_SIZE + 3];
+        u32 NewCacheCount = 0;
+        for (u32 k = 0; k < 3; ++k) {
+            u32 Vertex = Corners[k];
+            NewCache[NewCacheCount++] = Vertex;
+
+            // Swap the emitted triangle out of the vertex's active range
+            u32 *Triangles = Adjacency + AdjacencyOffsets[Vertex];
+            u32 Count = ActiveTriangleCounts[Vertex];
+            for (u32 t = 0; t < Count; ++t) {
+                if (Triangles[t] == BestTriangle) {
+                    Triangles[t] = Triangles[Count - 1];
+                    Triangles[Count - 1] = BestTriangle;
+                    break;
+                }
+            }
+            --ActiveTriangleCounts[Vertex];
+        }
+        for (u32 i = 0; i < CacheCount; ++i) {
+            u32 Vertex = Cache[i];
+            if (Vertex != Corners[0] && Vertex != Corners[1] && Vertex != Corners[2]) {
+                NewCache[NewCacheCount++] = Vertex;
+            }
+        }
+
+        for (u32 i = 0; i < NewCacheCount; ++i) {
+            u32 Vertex = NewCache[i];
+            CachePositions[Vertex] = (i < VERTEX_CACHE_SIZE) ? (i32)i : -1;
+            VertexScores[Vertex] = GetVertexScore(CachePositions[Vertex], ActiveTriangleCounts[Vertex]);
+        }
+
+        // Only triangles touching the cache changed score
+        BestScore = -1.f;
+        for (u32 i = 0; i < NewCacheCount; ++i) {
+            u32 Vertex = NewCache[i];
+            u32 *Triangles = Adjacency + AdjacencyOffsets[Vertex];
+            for (u32 t = 0; t < ActiveTriangleCounts[Vertex]; ++t) {
+                u32 Candidate = Triangles[t];
+                u16 *CandidateCorners = Indices + 3*Candidate;
+                f32 Score = VertexScores[CandidateCorners[0]] + VertexScores[CandidateCorners[1]] + VertexScores[CandidateCorners[2]];
+                TriangleScores[Candidate] = Score;
+                if (Score > BestScore) {
+                    BestScore = Score;
+                    BestTriangle = Candidate;
+                }
+            }
+        }
+
+        CacheCount = (NewCacheCount < VERTEX_CACHE_SIZE) ? NewCacheCount : VERTEX_CACHE_SIZE;
+        memcpy(Cache, NewCache, CacheCount*sizeof(u32));
+    }
+
+    memcpy(Indices, Output, IndexCount*sizeof(u16));
+    EndTemporaryMemory(Temp);
+    return true;
+}
+
+// Splits the cache-ordered triangles into clusters wherever the cache
+// restarts, then draws the clusters facing furthest out from the mesh's
+// center first, so they tend to occlude the rest. Clusters end only
+// where all three vertices missed, which keeps the cache order intact.
+// Returns false if the scratch arena is full, the indices are left as they were.
+static b32 OptimizeOverdraw(memory_arena *Scratch, u16 *Indices, u32 IndexCount, vertex *Vertices, u32 VertexCount) {
+    u32 TriangleCount = IndexCount/3;
+    if (TriangleCount < 2) {
+        return true;
+    }
+
+    temporary_memory Temp = BeginTemporaryMemory(Scratch);
+    u32 *CacheTimestamps = PushArray(Scratch, u32, VertexCount);
+    u32 *ClusterStarts = PushArray(Scratch, u32, (TriangleCount + 1));
+    if (!CacheTimestamps || !ClusterStarts) {
+        EndTemporaryMemory(Temp);
+        return false;
+    }
+    memset(CacheTimestamps, 0, VertexCount*sizeof(u32));
+
+    u32 ClusterCount = 0;
+    u32 Timestamp = VERTEX_CACHE_ANALYSIS_SIZE + 1;
+    for (u32 Triangle = 0; Triangle < TriangleCount; ++Triangle) {
+        u32 Misses = 0;
+        for (u32 k = 0; k < 3; ++k) {
+            u32 Index = Indices[3*Triangle + k];
+            if (Timestamp - CacheTimestamps[Index] > VERTEX_CACHE_ANALYSIS_SIZE) {
+                CacheTimestamps[Index] = Timestamp++;
+                ++Misses;
+            }
+        }
+        if (Triangle == 0 || Misses == 3) {
+            ClusterStarts[ClusterCount++] = Triangle;
+        }
+    }
+    ClusterStarts[ClusterCount] = TriangleCount;
+
+    if (ClusterCount > 1) {
+        vec3 MeshCenter = vec3();
+        for (u32 i = 0; i < IndexCount; ++i) {
+            MeshCenter = MeshCenter + Vertices[Indices[i]].Position;
+        }
+        MeshCenter = MeshCenter/(f32)IndexCount;
+
+        sort_entry *Entries = PushArray(Scratch, sort_entry, ClusterCount);
+        sort_entry *SortTemp = PushArray(Scratch, sort_entry, ClusterCount);
+        u16 *Output = PushArray(Scratch, u16, IndexCount);
+        if (!Entries || !SortTemp || !Output) {
+            EndTemporaryMemory(Temp);
+            return false;
+        }
+        for (u32 Cluster = 0; Cluster < ClusterCount; ++Cluster) {
+            // Area weighted normal and centroid
+            vec3 Normal = vec3();
+            vec3 Center = vec3();
+            f32 Area = 0.f;
+            for (u32 Triangle = ClusterStarts[Cluster]; Triangle < ClusterStarts[Cluster + 1]; ++Triangle) {
+                vec3 P0 = Vertices[Indices[3*Triangle + 0]].Position;
+                vec3 P1 = Vertices[Indices[3*Triangle + 1]].Position;
+                vec3 P2 = Vertices[Indices[3*Triangle + 2]].Position;
+                vec3 N = Cross(P1 - P0, P2 - P0);
+                f32 TriangleArea = Magnitude(N);
+                Normal = Normal + N;
+                Center = Center + (TriangleArea/3.f)*(P0 + P1 + P2);
+                Area += TriangleArea;
+            }
+            f32 Facing = 0.f;
+            if (Area > 0.f) {
+                Center = Center/Area;
+                Facing = Dot(Center - MeshCenter, Normal/Area);
+            }
+            // Flipped so the ascending sort puts the most outward first
+            Entries[Cluster].SortKey = ~SortKeyFromF32(Facing);
+            Entries[Cluster].Index = Cluster;
+        }
+        RadixSort(ClusterCount, Entries, SortTemp);
+
+        u32 OutputCount = 0;
+        for (u32 i = 0; i < ClusterCount; ++i) {
+            u32 Cluster = Entries[i].Index;
+            u32 First = 3*ClusterStarts[Cluster];
+            u32 Count = 3*(ClusterStarts[Cluster + 1] - ClusterStarts[Cluster]);
+            memcpy(Output + OutputCount, Indices + First, Count*sizeof(u16));
+            OutputCount += Count;
+        }
+        memcpy(Indices, Output, IndexCount*sizeof(u16));
+    }
+    EndTemporaryMemory(Temp);
+    return true;
+}
+
+// Renumbers vertices in the order the indices first use them and updates
+// the vertex count, vertices no index refers to are dropped. Returns false
+// if the scratch arena is full, the mesh is left as it was.
+static b32 OptimizeVertexFetch(memory_arena *Scratch, vertex *Vertices, u32 *VertexCount, u16 *Indices, u32 IndexCount) {
+    temporary_memory Temp = BeginTemporaryMemory(Scratch);
+    u32 *Remap = PushArray(Scratch, u32, *VertexCount);
+    vertex *Source = PushArray(Scratch, vertex, *VertexCount);
+    if (!Remap || !Source) {
+        EndTemporaryMemory(Temp);
+        return false;
+    }
+    memcpy(Source, Vertices, *VertexCount*sizeof(vertex));
+    memset(Remap, 0xFF, *VertexCount*sizeof(u32));
+
+    u32 NextVertex = 0;
+    for (u32 i = 0; i < IndexCount; ++i) {
+        u32 Index = Indices[i];
+        if (Remap[Index] == 0xFFFFFFFF) {
+            Remap[Index] = NextVertex;
+            Vertices[NextVertex++] = Source[Index];
+        }
+        Indices[i] = (u16)Remap[Index];
+    }
+    EndTemporaryMemory(Temp);
+    *VertexCount = NextVertex;
+    return true;
+}
+
+// Name is only for the report. Parts of a split mesh can share vertices,
+// so they only get their triangles reordered.
+static void OptimizeMesh(memory_arena *Scratch, mesh_object *Mesh, const char *Name, b32 ReduceOverdraw = true) {
+    if (Mesh->PartCount > 1) {
+        for (u32 i = 0; i < Mesh->PartCount; ++i) {
+            mesh_part *Part = Mesh->Parts + i;
+            u16 *Indices = Mesh->Indices + Part->FirstIndex;
+            if (!OptimizeVertexCache(Scratch, Indices, Part->IndexCount, Part->VertexCount) ||
+                    (ReduceOverdraw && !OptimizeOverdraw(Scratch, Indices, Part->IndexCount, Mesh->Vertices + Part->BaseVertex, Part->VertexCount))) {
+                LWARN("Scratch arena full, %s is not fully optimized.", Name);
+                return;
+            }
+        }
+        LINFO("Optimized %s: triangle order only, %u parts.", Name, Mesh->PartCount);
+        return;
+    }
+
+    vertex_cache_stats Before = AnalyzeVertexCache(Scratch, Mesh->Indices, Mesh->IndexCount, Mesh->VertexCount);
+    // Each step leaves a valid mesh, so a full scratch arena only stops
+    // the ones after it
+    if (!OptimizeVertexCache(Scratch, Mesh->Indices, Mesh->IndexCount, Mesh->VertexCount) ||
+            (ReduceOverdraw && !OptimizeOverdraw(Scratch, Mesh->Indices, Mesh->IndexCount, Mesh->Vertices, Mesh->VertexCount)) ||
+            !OptimizeVertexFetch(Scratch, Mesh->Vertices, &Mesh->VertexCount, Mesh->Indices, Mesh->IndexCount)) {
+        LWARN("Scratch arena full, %s is not fully optimized.", Name);
+        return;
+    }
+    Mesh->Parts[0].VertexCount = Mesh->VertexCount;
+    vertex_cache_stats After = AnalyzeVertexCache(Scratch, Mesh->Indices, Mesh->IndexCount, Mesh->VertexCount);
+    LINFO("Optimized %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f.", Name, Before.ACMR, After.ACMR, Before.ATVR, After.ATVR);
+}
@@ -0,0 +1,392 @@
+#pragma once
+
+//
+// Mesh simplifier
+//
+// Builds a mesh's LOD chain with quadric error edge collapses (Garland and
+// Heckbert). A collapse moves one vertex onto a neighbour, so every LOD
+// indexes a subset of LOD0's vertices and shares its vertex buffer.
+// Vertices on open borders and on attribute seams, where several vertices
+// share a position, are locked so outlines and UV or color splits don't
+// tear open.
+//
+// Collapses run in passes. Each pass sorts the candidate edges by error
+// and applies the cheapest ones whose neighbourhoods don't overlap, so a
+// collapse never sees topology an earlier one in the same pass changed.
+//
+#define MESH_LOD_TRIANGLE_RATIO 0.5f
+#define MESH_LOD_MIN_TRIANGLE_COUNT 32
+// A level that can't get below this fraction of the previous one isn't
+// worth a slot, the simplifier has run out of unlocked vertices
+#define MESH_LOD_MAX_KEPT_RATIO 0.8f
+#define MESH_SIMPLIFY_MAX_PASS_COUNT 64
+// Cosine of the most a collapse may turn a triangle
+#define MESH_SIMPLIFY_MIN_NORMAL_COS 0.5f
+
+// Symmetric 4x4 matrix, the sum of squared distances to a set of planes
+struct quadric {
+    f32 A2, AB, AC, AD;
+    f32 B2, BC, BD;
+    f32 C2, CD;
+    f32 D2;
+};
+
+struct edge_collapse {
+    u32 From;
+    u32 To;
+    f32 Error;
+};
+
+// Weighted by area so big triangles pull harder than slivers
+static inline quadric GetTriangleQuadric(vec3 P0, vec3 P1, vec3 P2) {
+    quadric Result = {};
+    vec3 Normal = Cross(P1 - P0, P2 - P0);
+    f32 DoubleArea = Magnitude(Normal);
+    if (DoubleArea > 0.f) {
+        Normal = Normal/DoubleArea;
+        f32 D = -Dot(Normal, P0);
+        f32 Weight = 0.5f*DoubleArea;
+        Result.A2 = Weight*Normal.x*Normal.x;
+        Result.AB = Weight*Normal.x*Normal.y;
+        Result.AC = Weight*Normal.x*Normal.z;
+        Result.AD = Weight*Normal.x*D;
+        Result.B2 = Weight*Normal.y*Normal.y;
+        Result.BC = Weight*Normal.y*Normal.z;
+        Result.BD = Weight*Normal.y*D;
+        Result.C2 = Weight*Normal.z*Normal.z;
+        Result.CD = Weight*Normal.z*D;
+        Result.D2 = Weight*D*D;
+    }
+    return Result;
+}
+
+static inline void AddQuadric(quadric *Q, quadric *Other) {
+    Q->A2 += Other->A2;
+    Q->AB += Other->AB;
+    Q->AC += Other->AC;
+    Q->AD += Other->AD;
+    Q->B2 += Other->B2;
+    Q->BC += Other->BC;
+    Q->BD += Other->BD;
+    Q->C2 += Other->C2;
+    Q->CD += Other->CD;
+    Q->D2 += Other->D2;
+}
+
+static inline f32 EvaluateQuadric(quadric *Q, quadric *Other, vec3 P) {
+    quadric Sum = *Q;
+    AddQuadric(&Sum, Other);
+    f32 Result = Sum.A2*P.x*P.x + 2.f*Sum.AB*P.x*P.y + 2.f*Sum.AC*P.x*P.z + 2.f*Sum.AD*P.x +
+        Sum.B2*P.y*P.y + 2.f*Sum.BC*P.y*P.z + 2.f*Sum.BD*P.y +
+        Sum.C2*P.z*P.z + 2.f*Sum.CD*P.z + Sum.D2;
+    return fabsf(Result);
+}
+
+// Open addressing, Table holds TableSize u64 keys and must be a power of
+// two comfortably bigger than the key count. Keys of ~0 mark empty slots.
+static inline u64 *FindEdgeSlot(u64 *Table, u32 TableSize, u64 Key) {
+    u32 Slot = (u32)HashFNV1a(&Key, sizeof(Key)) & (TableSize - 1);
+    while (Table[Slot] != ~0ull && Table[Slot] != Key) {
+        Slot = (Slot + 1) & (TableSize - 1);
+    }
+    return Table + Slot;
+}
+
+static inline u32 GetHashTableSize(u32 Count) {
+    u32 Result = 1;
+    while (Result < 2*Count) {
+        Result *= 2;
+    }
+    return Result;
+}
+
+// Locks the endpoints of every edge without a twin going the other way,
+// and every vertex whose position another vertex shares. Returns false if
+// scratch ran out.
+static b32 LockBorderAndSeamVertices(memory_arena *Scratch, vertex *Vertices, u32 VertexCount, u16 *Indices, u32 IndexCount, b8 *Locked) {
+    memset(Locked, 0, VertexCount*sizeof(b8));
+
+    temporary_memory Temp = BeginTemporaryMemory(Scratch);
+    u32 EdgeTableSize = GetHashTableSize(IndexCount);
+    u32 PositionTableSize = GetHashTableSize(VertexCount);
+    u64 *Edges = PushArray(Scratch, u64, EdgeTableSize);
+    u32 *Positions = PushArray(Scratch, u32, PositionTableSize);
+    if (!Edges || !Positions) {
+        EndTemporaryMemory(Temp);
+        return false;
+    }
+
+    memset(Edges, 0xFF, EdgeTableSize*sizeof(u64));
+    for (u32 i = 0; i < IndexCount; ++i) {
+        u32 Next = (i % 3 == 2) ? i - 2 : i + 1;
+        u64 Key = ((u64)Indices[i] << 32) | Indices[Next];
+        *FindEdgeSlot(Edges, EdgeTableSize, Key) = Key;
+    }
+    for (u32 i = 0; i < IndexCount; ++i) {
+        u32 Next = (i % 3 == 2) ? i - 2 : i + 1;
+        u64 Twin = ((u64)Indices[Next] << 32) | Indices[i];
+        if (*FindEdgeSlot(Edges, EdgeTableSize, Twin) != Twin) {
+            Locked[Indices[i]] = true;
+            Locked[Indices[Next]] = true;
+        }
+    }
+
+    memset(Positions, 0xFF, PositionTableSize*sizeof(u32));
+    for (u32 Vertex = 0; Vertex < VertexCount; ++Vertex) {
+        vec3 P = Vertices[Vertex].Position;
+        u32 Slot = (u32)HashFNV1a(&P, sizeof(P)) & (PositionTableSize - 1);
+        while (Positions[Slot] != 0xFFFFFFFF) {
+            u32 Other = Positions[Slot];
+            if (memcmp(&Vertices[Other].Position, &P, sizeof(P)) == 0) {
+                Locked[Other] = true;
+                Locked[Vertex] = true;
+                break;
+            }
+            Slot = (Slot + 1) & (PositionTableSize - 1);
+        }
+        if (Positions[Slot] == 0xFFFFFFFF) {
+            Positions[Slot] = Vertex;
+        }
+    }
+
+    EndTemporaryMemory(Temp);
+    return true;
+}
+
+// True if moving From onto To turns no triangle around From by more than
+// 60 degrees. Small turns add up over passes and LODs, so rejecting only
+// outright flips isn't enough.
+static b32 IsCollapseValid(vertex *Vertices, u16 *Indices, u32 *Triangles, u32 TriangleCount, u32 From, u32 To) {
+    vec3 Target = Vertices[To].Position;
+    for (u32 t = 0; t < TriangleCount; ++t) {
+        u16 *Corners = Indices + 3*Triangles[t];
+        if (Corners[0] == To || Corners[1] == To || Corners[2] == To) {
+            // Degenerates and is dropped
+            continue;
+        }
+        vec3 P[3];
+        vec3 Moved[3];
+        for (u32 k = 0; k < 3; ++k) {
+            P[k] = Vertices[Corners[k]].Position;
+            Moved[k] = (Corners[k] == From) ? Target : P[k];
+        }
+        vec3 Before = Cross(P[1] - P[0], P[2] - P[0]);
+        vec3 After = Cross(Moved[1] - Moved[0], Moved[2] - Moved[0]);
+        if (Dot(Before, After) <= MESH_SIMPLIFY_MIN_NORMAL_COS*Magnitude(Before)*Magnitude(After)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes at most IndexCount indices to Output, fewer triangles than
+// TargetIndexCount only if a pass overshoots. Returns the output index
+// count, or 0 if scratch ran out. Error is the largest collapse error.
+static u32 SimplifyMesh(memory_arena *Scratch, vertex *Vertices, u32 VertexCount, u16 *Indices, u32 IndexCount,
+        u32 TargetIndexCount, u16 *Output, f32 *Error) {
+    temporary_memory Temp = BeginTemporaryMemory(Scratch);
+    b8 *Locked = PushArray(Scratch, b8, VertexCount);
+    b8 *Touched = PushArray(Scratch, b8, VertexCount);
+    u32 *Remap = PushArray(Scratch, u32, VertexCount);
+    quadric *Quadrics = PushArray(Scratch, quadric, VertexCount);
+    u32 *AdjacencyOffsets = PushArray(Scratch, u32, VertexCount + 1);
+    u32 *Adjacency = PushArray(Scratch, u32, IndexCount);
+    edge_collapse *Collapses = PushArray(Scratch, edge_collapse, IndexCount);
+    sort_entry *SortEntries = PushArray(Scratch, sort_entry, IndexCount);
+    sort_entry *SortTemp = PushArray(Scratch, sort_entry, IndexCount);
+    if (!Locked || !Touched || !Remap || !Quadrics || !AdjacencyOffsets || !Adjacency ||
+            !Collapses || !SortEntries || !SortTemp ||
+            !LockBorderAndSeamVertices(Scratch, Vertices, VertexCount, Indices, IndexCount, Locked)) {
+        EndTemporaryMemory(Temp);
+        return 0;
+    }
+
+    memcpy(Output, Indices, IndexCount*sizeof(u16));
+    u32 Count = IndexCount;
+
+    memset(Quadrics, 0, VertexCount*sizeof(quadric));
+    for (u32 i = 0; i < Count; i += 3) {
+        quadric Q = GetTriangleQuadric(Vertices[Output[i + 0]].Position, Vertices[Output[i + 1]].Position, Vertices[Output[i + 2]].Position);
+        for (u32 k = 0; k < 3; ++k) {
+            AddQuadric(Quadrics + Output[i + k], &Q);
+        }
+    }
+
+    f32 MaxError = 0.f;
+    for (u32 Pass = 0; Pass < MESH_SIMPLIFY_MAX_PASS_COUNT && Count > TargetIndexCount; ++Pass) {
+        u32 TriangleCount = Count/3;
+
+        // Triangles of each vertex, packed in one array
+        memset(AdjacencyOffsets, 0, (VertexCount + 1)*sizeof(u32));
+        for (u32 i = 0; i < Count; ++i) {
+            ++AdjacencyOffsets[Output[i] + 1];
+        }
+        for (u32 i = 0; i < VertexCount; ++i) {
+            AdjacencyOffsets[i + 1] += AdjacencyOffsets[i];
+        }
+        for (u32 i = 0; i < Count; ++i) {
+            Adjacency[AdjacencyOffsets[Output[i]]++] = i/3;
+        }
+        for (u32 i = VertexCount; i > 0; --i) {
+            AdjacencyOffsets[i] = AdjacencyOffsets[i - 1];
+        }
+        AdjacencyOffsets[0] = 0;
+
+        // Each edge once, in whichever direction is cheaper
+        u32 CollapseCount = 0;
+        for (u32 i = 0; i < Count; ++i) {
+            u32 A = Output[i];
+            u32 B = Output[(i % 3 == 2) ? i - 2 : i + 1];
+            if (A > B || (Locked[A] && Locked[B])) {
+                continue;
+            }
+            quadric *QA = Quadrics + A;
+            quadric *QB = Quadrics + B;
+            f32 ErrorAB = Locked[A] ? FLT_MAX : EvaluateQuadric(QA, QB, Vertices[B].Position);
+            f32 ErrorBA = Locked[B] ? FLT_MAX : EvaluateQuadric(QA, QB, Vertices[A].Position);
+            edge_collapse *Collapse = Collapses + CollapseCount;
+            Collapse->From = (ErrorAB <= ErrorBA) ? A : B;
+            Collapse->To = (ErrorAB <= ErrorBA) ? B : A;
+            Collapse->Error = (ErrorAB <= ErrorBA) ? ErrorAB : ErrorBA;
+            SortEntries[CollapseCount].SortKey = SortKeyFromF32(Collapse->Error);
+            SortEntries[CollapseCount].Index = CollapseCount;
+            ++CollapseCount;
+        }
+        RadixSort(CollapseCount, SortEntries, SortTemp);
+
+        // An interior collapse removes two triangles
+        u32 WantedCollapseCount = (TriangleCount - TargetIndexCount/3 + 1)/2;
+        u32 AppliedCount = 0;
+        memset(Touched, 0, VertexCount*sizeof(b8));
+        for (u32 i = 0; i < VertexCount; ++i) {
+            Remap[i] = i;
+        }
+        for (u32 i = 0; i < CollapseCount && AppliedCount < WantedCollapseCount; ++i) {
+            edge_collapse *Collapse = Collapses + SortEntries[i].Index;
+            u32 From = Collapse->From;
+            u32 To = Collapse->To;
+            if (Touched[From] || Touched[To]) {
+                continue;
+            }
+            u32 *Triangles = Adjacency + AdjacencyOffsets[From];
+            u32 FromTriangleCount = AdjacencyOffsets[From + 1] - AdjacencyOffsets[From];
+            if (!IsCollapseValid(Vertices, Output, Triangles, FromTriangleCount, From, To)) {
+                continue;
+            }
+
+            // Keep the whole one-ring of From still for the rest of the pass
+            for (u32 t = 0; t < FromTriangleCount; ++t) {
+                u16 *Corners = Output + 3*Triangles[t];
+                Touched[Corners[0]] = true;
+                Touched[Corners[1]] = true;
+                Touched[Corners[2]] = true;
+            }
+            Remap[From] = To;
+            AddQuadric(Quadrics + To, Quadrics + From);
+            if (Collapse->Error > MaxError) {
+                MaxError = Collapse->Error;
+            }
+            ++AppliedCount;
+        }
+        if (AppliedCount == 0) {
+            break;
+        }
+
+        u32 NewCount = 0;
+        for (u32 i = 0; i < Count; i += 3) {
+            u32 V0 = Remap[Output[i + 0]];
+            u32 V1 = Remap[Output[i + 1]];
+            u32 V2 = Remap[Output[i + 2]];
+            if (V0 != V1 && V1 != V2 && V2 != V0) {
+                Output[NewCount++] = (u16)V0;
+                Output[NewCount++] = (u16)V1;
+                Output[NewCount++] = (u16)V2;
+            }
+        }
+        Count = NewCount;
+    }
+
+    EndTemporaryMemory(Temp);
+    *Error = MaxError;
+    return Count;
+}
+
+// Adds LODs after LOD0 until one stops getting meaningfully smaller, each
+// as one more part. The LOD indices are appended to Mesh->Indices, which
+// is moved into IndexArena unless it already ends at the top of it. Split
+// meshes are left with LOD0 only.
+static void GenerateMeshLODs(memory_arena *IndexArena, memory_arena *Scratch, mesh_object *Mesh, const char *Name) {
+    Assert(Mesh->LODCount == 1);
+    if (Mesh->PartCount != 1) {
+        return;
+    }
+
+    temporary_memory Temp = BeginTemporaryMemory(Scratch);
+    // Each level is at most MESH_LOD_MAX_KEPT_RATIO of the one before
+    u32 MaxLODIndexCount = (MAX_MESH_LOD_COUNT - 1)*Mesh->IndexCount;
+    u16 *LODIndices = PushArray(Scratch, u16, MaxLODIndexCount);
+    if (!LODIndices) {
+        LWARN("Scratch arena full, %s has no LODs.", Name);
+        EndTemporaryMemory(Temp);
+        return;
+    }
+
+    u32 LODIndexCount = 0;
+    u16 *Source = Mesh->Indices;
+    u32 SourceCount = Mesh->IndexCount;
+    f32 Errors[MAX_MESH_LOD_COUNT] = {};
+    while (Mesh->LODCount < MAX_MESH_LOD_COUNT && SourceCount/3 >= 2*MESH_LOD_MIN_TRIANGLE_COUNT) {
+        u32 TargetIndexCount = 3*(u32)(MESH_LOD_TRIANGLE_RATIO*(SourceCount/3));
+        u16 *Output = LODIndices + LODIndexCount;
+        u32 Count = SimplifyMesh(Scratch, Mesh->Vertices, Mesh->VertexCount, Source, SourceCount,
+                TargetIndexCount, Output, Errors + Mesh->LODCount);
+        if (Count == 0 || Count > (u32)(MESH_LOD_MAX_KEPT_RATIO*SourceCount)) {
+            break;
+        }
+        OptimizeVertexCache(Scratch, Output, Count, Mesh->VertexCount);
+
+        mesh_part *Part = Mesh->Parts + Mesh->PartCount;
+        Part->BaseVertex = 0;
+        Part->VertexCount = Mesh->VertexCount;
+        Part->FirstIndex = Mesh->IndexCount + LODIndexCount;
+        Part->IndexCount = Count;
+        mesh_lod *LOD = Mesh->LODs + Mesh->LODCount++;
+        LOD->FirstPart = Mesh->PartCount++;
+        LOD->PartCount = 1;
+        LODIndexCount += Count;
+        Source = Output;
+        SourceCount = Count;
+    }
+
+    if (LODIndexCount) {
+        u16 *Indices = 0;
+        if ((u8 *)(Mesh->Indices + Mesh->IndexCount) == IndexArena->Base + IndexArena->Used) {
+            // LOD0 was the last thing pushed, the LODs can just follow it
+            if (PushArray(IndexArena, u16, LODIndexCount)) {
+                Indices = Mesh->Indices;
+            }
+        }
+        else {
+            Indices = PushArray(IndexArena, u16, Mesh->IndexCount + LODIndexCount);
+            if (Indices) {
+                memcpy(Indices, Mesh->Indices, Mesh->IndexCount*sizeof(u16));
+            }
+        }
+
+        if (Indices) {
+            memcpy(Indices + Mesh->IndexCount, LODIndices, LODIndexCount*sizeof(u16));
+            Mesh->Indices = Indices;
+            Mesh->IndexCount += LODIndexCount;
+        }
+        else {
+            LWARN("Index arena full, %s has no LODs.", Name);
+            Mesh->PartCount = 1;
+            Mesh->LODCount = 1;
+        }
+    }
+    EndTemporaryMemory(Temp);
+
+    for (u32 i = 1; i < Mesh->LODCount; ++i) {
+        LINFO("%s LOD%u: %u triangles, error %.4f.", Name, i, Mesh->Parts[Mesh->LODs[i].FirstPart].IndexCount/3, Errors[i]);
+    }
+}
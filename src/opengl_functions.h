@@ -35,8 +35,10 @@
 #define GL_ARRAY_BUFFER_BINDING           0x8894
 #define GL_ELEMENT_ARRAY_BUFFER_BINDING   0x8895
 
+#define GL_DRAW_INDIRECT_BUFFER           0x8F3F
 #define GL_ARRAY_BUFFER                   0x8892
 #define GL_ELEMENT_ARRAY_BUFFER           0x8893
+#define GL_PIXEL_PACK_BUFFER              0x88EB
 #define GL_STREAM_DRAW                    0x88E0
 #define GL_STREAM_READ                    0x88E1
 #define GL_STREAM_COPY                    0x88E2
@@ -154,9 +156,34 @@
 #define GL_MAX_COLOR_TEXTURE_SAMPLES      0x910E
 #define GL_MAX_DEPTH_TEXTURE_SAMPLES      0x910F
 
+#define GL_RGBA16F                        0x881A
+#define GL_R16F                           0x822D
+
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH          0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS     0x87FE
+
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR          0x91B1
+
+#define GL_QUERY_RESULT                   0x8866
+#define GL_QUERY_RESULT_AVAILABLE         0x8867
+#define GL_FRAGMENT_SHADER_INVOCATIONS    0x82F4
+#define GL_TIMESTAMP                      0x8E28
+
+#define GL_SYNC_GPU_COMMANDS_COMPLETE     0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT        0x00000001
+#define GL_ALREADY_SIGNALED               0x911A
+#define GL_TIMEOUT_EXPIRED                0x911B
+#define GL_CONDITION_SATISFIED            0x911C
+#define GL_WAIT_FAILED                    0x911D
+
 typedef char GLchar;
 typedef ptrdiff_t GLsizeiptr;
 typedef ptrdiff_t GLintptr;
+typedef int64_t GLint64;
+typedef uint64_t GLuint64;
+typedef struct __GLsync *GLsync;
 
 typedef GLuint gl_create_shader(GLenum type);
 typedef void   gl_delete_shader(GLuint shader);
@@ -209,51 +236,121 @@ typedef void gl_gen_buffers(GLsizei n, GLuint *buffers);
 typedef void gl_bind_buffer(GLenum target, GLuint buffer);
 typedef void gl_buffer_data(GLenum target, GLsizeiptr size, const void *data, GLenum usage);
 typedef void gl_buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, const void *data);
+typedef void gl_get_buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, void *data);
 static gl_gen_vertex_arrays *glGenVertexArrays;
 static gl_bind_vertex_array *glBindVertexArray;
 static gl_gen_buffers *glGenBuffers;
 static gl_bind_buffer *glBindBuffer;
 static gl_buffer_data *glBufferData;
 static gl_buffer_sub_data *glBufferSubData;
+static gl_get_buffer_sub_data *glGetBufferSubData;
 
 typedef void gl_draw_elements_base_vertex(GLenum mode, GLsizei count, GLenum type, GLvoid *indices, GLint basevertex);
 static gl_draw_elements_base_vertex *glDrawElementsBaseVertex;
 
+typedef void gl_draw_elements_instanced_base_vertex_base_instance(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount, GLint basevertex, GLuint baseinstance);
+static gl_draw_elements_instanced_base_vertex_base_instance *glDrawElementsInstancedBaseVertexBaseInstance;
+
+typedef void gl_draw_arrays_instanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount);
+static gl_draw_arrays_instanced *glDrawArraysInstanced;
+
+typedef void gl_multi_draw_elements_indirect(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+static gl_multi_draw_elements_indirect *glMultiDrawElementsIndirect;
+
 typedef GLint gl_get_attrib_location(GLuint program, const GLchar *name);
 typedef void  gl_bind_attrib_location(GLuint program, GLuint index, const GLchar *name);
 typedef void  gl_enable_vertex_attrib_array(GLuint index);
 typedef void  gl_disable_vertex_attrib_array(GLuint index);
 typedef void  gl_vertex_attrib_pointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
 typedef void  gl_vertex_attribi_pointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void *pointer);
+typedef void  gl_vertex_attrib_divisor(GLuint index, GLuint divisor);
 static gl_get_attrib_location *glGetAttribLocation;
 static gl_bind_attrib_location *glBindAttribLocation;
 static gl_enable_vertex_attrib_array *glEnableVertexAttribArray;
 static gl_disable_vertex_attrib_array *glDisableVertexAttribArray;
 static gl_vertex_attrib_pointer *glVertexAttribPointer;
 static gl_vertex_attribi_pointer *glVertexAttribIPointer;
+static gl_vertex_attrib_divisor *glVertexAttribDivisor;
 
 typedef void gl_gen_framebuffers(GLsizei n, GLuint *framebuffers);
+typedef void gl_delete_framebuffers(GLsizei n, const GLuint *framebuffers);
 typedef void gl_bind_framebuffer(GLenum target, GLuint buffer);
 typedef void gl_framebuffer_texture_2d(	GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
 typedef GLenum gl_check_framebuffer_status(GLenum target);
 typedef void gl_tex_image_2d_multisample(GLenum target, GLsizei samples, GLint internalformat, GLsizei width, GLsizei height, GLboolean fixedsamplelocations);
 typedef void gl_blit_framebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter);
+typedef void gl_invalidate_framebuffer(GLenum target, GLsizei numAttachments, const GLenum *attachments);
 static gl_gen_framebuffers *glGenFramebuffers;
+static gl_delete_framebuffers *glDeleteFramebuffers;
 static gl_bind_framebuffer *glBindFramebuffer;
 static gl_framebuffer_texture_2d *glFramebufferTexture2D;
 static gl_check_framebuffer_status *glCheckFramebufferStatus;
 static gl_tex_image_2d_multisample *glTexImage2DMultisample;
 static gl_blit_framebuffer *glBlitFramebuffer;
+static gl_invalidate_framebuffer *glInvalidateFramebuffer;
 
 typedef void gl_gen_render_buffers(GLsizei n, GLuint *renderbuffers);
+typedef void gl_delete_render_buffers(GLsizei n, const GLuint *renderbuffers);
+typedef void gl_render_buffer_storage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
 typedef void gl_bind_renderbuffer(GLenum target, GLuint renderbuffer);
 typedef void gl_render_buffer_storage_multisample(GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height);
 typedef void gl_framebuffer_renderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer);
 static gl_gen_render_buffers *glGenRenderbuffers;
+static gl_delete_render_buffers *glDeleteRenderbuffers;
+static gl_render_buffer_storage *glRenderbufferStorage;
 static gl_bind_renderbuffer *glBindRenderbuffer;
 static gl_render_buffer_storage_multisample *glRenderbufferStorageMultisample;
 static gl_framebuffer_renderbuffer *glFramebufferRenderbuffer;
 
+typedef void gl_get_program_binary(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void gl_program_binary(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void gl_program_parameteri(GLuint program, GLenum pname, GLint value);
+static gl_get_program_binary *glGetProgramBinary;
+static gl_program_binary *glProgramBinary;
+static gl_program_parameteri *glProgramParameteri;
+
+// KHR_parallel_shader_compile, or the ARB version of the same entry point
+typedef void gl_max_shader_compiler_threads_khr(GLuint count);
+static gl_max_shader_compiler_threads_khr *glMaxShaderCompilerThreadsKHR;
+
+typedef void gl_active_texture(GLenum texture);
+typedef void gl_draw_buffers(GLsizei n, const GLenum *bufs);
+typedef void gl_blend_funci(GLuint buf, GLenum sfactor, GLenum dfactor);
+typedef void gl_clear_bufferfv(GLenum buffer, GLint drawbuffer, const GLfloat *value);
+typedef void gl_clear_bufferuiv(GLenum buffer, GLint drawbuffer, const GLuint *value);
+typedef void gl_color_maski(GLuint buf, GLboolean r, GLboolean g, GLboolean b, GLboolean a);
+static gl_active_texture *glActiveTexture;
+static gl_draw_buffers *glDrawBuffers;
+static gl_blend_funci *glBlendFunci;
+static gl_clear_bufferfv *glClearBufferfv;
+static gl_clear_bufferuiv *glClearBufferuiv;
+static gl_color_maski *glColorMaski;
+
+typedef const GLubyte *gl_get_stringi(GLenum name, GLuint index);
+static gl_get_stringi *glGetStringi;
+
+typedef void gl_gen_queries(GLsizei n, GLuint *ids);
+typedef void gl_delete_queries(GLsizei n, const GLuint *ids);
+typedef void gl_begin_query(GLenum target, GLuint id);
+typedef void gl_end_query(GLenum target);
+typedef void gl_get_query_objectuiv(GLuint id, GLenum pname, GLuint *params);
+typedef void gl_get_query_objectui64v(GLuint id, GLenum pname, GLuint64 *params);
+typedef void gl_query_counter(GLuint id, GLenum target);
+static gl_gen_queries *glGenQueries;
+static gl_delete_queries *glDeleteQueries;
+static gl_begin_query *glBeginQuery;
+static gl_end_query *glEndQuery;
+static gl_get_query_objectuiv *glGetQueryObjectuiv;
+static gl_get_query_objectui64v *glGetQueryObjectui64v;
+static gl_query_counter *glQueryCounter;
+
+typedef GLsync gl_fence_sync(GLenum condition, GLbitfield flags);
+typedef GLenum gl_client_wait_sync(GLsync sync, GLbitfield flags, GLuint64 timeout);
+typedef void gl_delete_sync(GLsync sync);
+static gl_fence_sync *glFenceSync;
+static gl_client_wait_sync *glClientWaitSync;
+static gl_delete_sync *glDeleteSync;
+
 typedef void debug_callback(GLenum source,GLenum type,GLuint id,GLenum severity,GLsizei length,const GLchar *message,const void *userParam);
 typedef void gl_debug_message_callback(debug_callback callback, const void *userParam);
 static gl_debug_message_callback *glDebugMessageCallback;
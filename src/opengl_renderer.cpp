@@ -16,67 +16,352 @@ void DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsiz
     }
 }
 
-static inline void OpenGLCreateMesh(opengl *OpenGL, mesh_index Index, mesh_object *Mesh) {
-    Assert(Mesh->Vertices);
-    Assert(Mesh->Indices);
+//
+// Static geometry
+//
+// Every static mesh lives in one vertex buffer and one index buffer behind
+// a single VAO, so any number of them draw without rebinding and a run of
+// them can go out as one multi-draw.
+//
+static void InitBufferAllocator(opengl_buffer_allocator *Allocator, u32 Capacity) {
+    *Allocator = {};
+    Allocator->Capacity = Capacity;
+    Allocator->FreeBlockCount = 1;
+    Allocator->FreeBlocks[0].Offset = 0;
+    Allocator->FreeBlocks[0].Count = Capacity;
+}
 
-    GLuint VAO;
-    GLuint VBO;
-    GLuint IBO;
+// Returns BUFFER_ALLOCATION_FAILED when no free block is large enough
+static u32 AllocateBufferRange(opengl_buffer_allocator *Allocator, u32 Count) {
+    u32 Result = BUFFER_ALLOCATION_FAILED;
+    for (u32 i = 0; i < Allocator->FreeBlockCount; ++i) {
+        opengl_buffer_block *Block = Allocator->FreeBlocks + i;
+        if (Block->Count >= Count) {
+            Result = Block->Offset;
+            Block->Offset += Count;
+            Block->Count -= Count;
+            if (Block->Count == 0) {
+                --Allocator->FreeBlockCount;
+                for (u32 j = i; j < Allocator->FreeBlockCount; ++j) {
+                    Allocator->FreeBlocks[j] = Allocator->FreeBlocks[j + 1];
+                }
+            }
+            Allocator->UsedCount += Count;
+            break;
+        }
+    }
+    return Result;
+}
 
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &IBO);
+static void FreeBufferRange(opengl_buffer_allocator *Allocator, u32 Offset, u32 Count) {
+    Assert(Offset + Count <= Allocator->Capacity);
+    u32 Index = 0;
+    while (Index < Allocator->FreeBlockCount && Allocator->FreeBlocks[Index].Offset < Offset) {
+        ++Index;
+    }
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
+    opengl_buffer_block *Prev = (Index > 0) ? Allocator->FreeBlocks + Index - 1 : 0;
+    opengl_buffer_block *Next = (Index < Allocator->FreeBlockCount) ? Allocator->FreeBlocks + Index : 0;
+    b32 MergePrev = (Prev && Prev->Offset + Prev->Count == Offset);
+    b32 MergeNext = (Next && Offset + Count == Next->Offset);
+
+    if (MergePrev && MergeNext) {
+        Prev->Count += Count + Next->Count;
+        --Allocator->FreeBlockCount;
+        for (u32 j = Index; j < Allocator->FreeBlockCount; ++j) {
+            Allocator->FreeBlocks[j] = Allocator->FreeBlocks[j + 1];
+        }
+    }
+    else if (MergePrev) {
+        Prev->Count += Count;
+    }
+    else if (MergeNext) {
+        Next->Offset = Offset;
+        Next->Count += Count;
+    }
+    else if (Allocator->FreeBlockCount < ArrayCount(Allocator->FreeBlocks)) {
+        for (u32 j = Allocator->FreeBlockCount; j > Index; --j) {
+            Allocator->FreeBlocks[j] = Allocator->FreeBlocks[j - 1];
+        }
+        Allocator->FreeBlocks[Index].Offset = Offset;
+        Allocator->FreeBlocks[Index].Count = Count;
+        ++Allocator->FreeBlockCount;
+    }
+    else {
+        // Too fragmented to track, the range is lost until shutdown
+        LWARN("Buffer free list full, leaking %u elements at %u.", Count, Offset);
+        return;
+    }
+    Allocator->UsedCount -= Count;
+}
+
+static inline size_t GetStaticMeshBytes(mesh_object *Mesh) {
+    size_t Result = Mesh->VertexCount*sizeof(vertex) + Mesh->IndexCount*sizeof(u16);
+    return Result;
+}
+
+// Releases the mesh's ranges but keeps its Source, so it can come back
+static void EvictStaticMesh(opengl_static_geometry *Geometry, opengl_static_mesh *StaticMesh) {
+    if (StaticMesh->Resident) {
+        FreeBufferRange(&Geometry->VertexAllocator, StaticMesh->BaseVertex, StaticMesh->VertexCount);
+        FreeBufferRange(&Geometry->IndexAllocator, StaticMesh->FirstIndex, StaticMesh->IndexCount);
+        Geometry->ResidentBytes -= GetStaticMeshBytes(StaticMesh->Source);
+        StaticMesh->Resident = false;
+    }
+}
+
+// Returns false when every resident mesh was drawn this frame
+static b32 EvictLeastRecentlyUsedMesh(opengl_static_geometry *Geometry) {
+    opengl_static_mesh *Oldest = 0;
+    for (u32 i = 0; i < ArrayCount(Geometry->Meshes); ++i) {
+        opengl_static_mesh *StaticMesh = Geometry->Meshes + i;
+        if (StaticMesh->Resident && StaticMesh->LastUsedFrame < Geometry->FrameIndex &&
+                (!Oldest || StaticMesh->LastUsedFrame < Oldest->LastUsedFrame)) {
+            Oldest = StaticMesh;
+        }
+    }
+    if (Oldest) {
+        EvictStaticMesh(Geometry, Oldest);
+        ++Geometry->EvictionCount;
+    }
+    return (Oldest != 0);
+}
+
+// Evicts until the mesh fits both the budget and the free lists, then
+// takes its ranges. It counts against the budget from here on.
+static b32 AllocateStaticMesh(opengl_static_geometry *Geometry, opengl_static_mesh *StaticMesh) {
+    mesh_object *Mesh = StaticMesh->Source;
+    Assert(Mesh);
+    Assert(!StaticMesh->Resident && !StaticMesh->Streaming);
+
+    size_t Bytes = GetStaticMeshBytes(Mesh);
+    while (Geometry->ResidentBytes + Bytes > Geometry->BudgetBytes) {
+        if (!EvictLeastRecentlyUsedMesh(Geometry)) {
+            LWARN("Mesh of %zu bytes doesn't fit the %zu byte budget.", Bytes, Geometry->BudgetBytes);
+            return false;
+        }
+    }
+
+    u32 BaseVertex = AllocateBufferRange(&Geometry->VertexAllocator, Mesh->VertexCount);
+    while (BaseVertex == BUFFER_ALLOCATION_FAILED && EvictLeastRecentlyUsedMesh(Geometry)) {
+        BaseVertex = AllocateBufferRange(&Geometry->VertexAllocator, Mesh->VertexCount);
+    }
+    if (BaseVertex == BUFFER_ALLOCATION_FAILED) {
+        LERROR("Static vertex buffer full, mesh with %u vertices not uploaded.", Mesh->VertexCount);
+        return false;
+    }
+    u32 FirstIndex = AllocateBufferRange(&Geometry->IndexAllocator, Mesh->IndexCount);
+    while (FirstIndex == BUFFER_ALLOCATION_FAILED && EvictLeastRecentlyUsedMesh(Geometry)) {
+        FirstIndex = AllocateBufferRange(&Geometry->IndexAllocator, Mesh->IndexCount);
+    }
+    if (FirstIndex == BUFFER_ALLOCATION_FAILED) {
+        FreeBufferRange(&Geometry->VertexAllocator, BaseVertex, Mesh->VertexCount);
+        LERROR("Static index buffer full, mesh with %u indices not uploaded.", Mesh->IndexCount);
+        return false;
+    }
 
-    size_t VerticesSize = Mesh->VertexCount*sizeof(vertex);
-    size_t IndicesSize = Mesh->IndexCount*sizeof(u16);
-    glBufferData(GL_ARRAY_BUFFER, VerticesSize, Mesh->Vertices, GL_STATIC_DRAW);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, IndicesSize, Mesh->Indices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(vertex), (void *)offsetof(vertex, Position));
-    glVertexAttribPointer(1, 4, GL_FLOAT, false, sizeof(vertex), (void *)offsetof(vertex, Color));
+    StaticMesh->BaseVertex = BaseVertex;
+    StaticMesh->VertexCount = Mesh->VertexCount;
+    StaticMesh->FirstIndex = FirstIndex;
+    StaticMesh->IndexCount = Mesh->IndexCount;
+    Geometry->ResidentBytes += Bytes;
+    return true;
+}
 
-    OpenGL->Meshes[Index].VAO = VAO;
-    OpenGL->Meshes[Index].VBO = VBO;
-    OpenGL->Meshes[Index].IBO = IBO;
+// Copies a range of the source's vertices and indices into the mesh's
+// ranges. The index buffer is only reachable through the VAO's element
+// binding.
+static void CopyStaticMeshRange(opengl_static_geometry *Geometry, opengl_static_mesh *StaticMesh,
+        u32 FirstVertex, u32 VertexCount, u32 FirstIndex, u32 IndexCount) {
+    mesh_object *Mesh = StaticMesh->Source;
+    glBindVertexArray(Geometry->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, Geometry->VBO);
+    if (VertexCount) {
+        glBufferSubData(GL_ARRAY_BUFFER, (StaticMesh->BaseVertex + FirstVertex)*sizeof(vertex),
+                VertexCount*sizeof(vertex), Mesh->Vertices + FirstVertex);
+    }
+    if (IndexCount) {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (StaticMesh->FirstIndex + FirstIndex)*sizeof(u16),
+                IndexCount*sizeof(u16), Mesh->Indices + FirstIndex);
+    }
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-static GLuint CompileShader(char *VertexShaderSource, char *FragmentShaderSource) {
-    GLint Success;
+static void OpenGLDeleteMesh(opengl *OpenGL, u32 Slot) {
+    Assert(Slot < MAX_MESH_COUNT);
+    opengl_static_geometry *Geometry = &OpenGL->StaticGeometry;
+    opengl_static_mesh *StaticMesh = Geometry->Meshes + Slot;
+    // Work is taken in order and a stream finishes before the next is
+    // taken, so nothing can delete a mesh halfway in
+    Assert(!StaticMesh->Streaming);
+    EvictStaticMesh(Geometry, StaticMesh);
+    *StaticMesh = {};
+}
 
-    GLuint VertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(VertexShader, 1, &VertexShaderSource, 0);
-    glCompileShader(VertexShader);
-    glGetShaderiv(VertexShader, GL_COMPILE_STATUS, &Success);
-    if (Success != GL_TRUE) {
-        char Buffer[1024] = {};
-        glGetShaderInfoLog(VertexShader, sizeof(Buffer), 0, Buffer);
-        LERROR("Vertex Shader: %s", Buffer);
+// Takes the mesh's ranges, the copy is left to StreamMeshUploads
+static inline b32 OpenGLCreateMesh(opengl *OpenGL, u32 Slot, mesh_object *Mesh) {
+    Assert(Mesh->Vertices);
+    Assert(Mesh->Indices);
+
+    // Uploading the same slot again replaces the old copy
+    OpenGLDeleteMesh(OpenGL, Slot);
+
+    opengl_static_geometry *Geometry = &OpenGL->StaticGeometry;
+    opengl_static_mesh *StaticMesh = Geometry->Meshes + Slot;
+    StaticMesh->Source = Mesh;
+    // Newest in LRU order, but unlike a mesh drawn this frame it can
+    // still make room for the rest of the upload queue
+    StaticMesh->LastUsedFrame = Geometry->FrameIndex - 1;
+    if (!AllocateStaticMesh(Geometry, StaticMesh)) {
+        return false;
+    }
+    StaticMesh->Streaming = true;
+    return true;
+}
+
+// A slot that is deleted while queued keeps its entry, it's skipped
+// once its flag is found cleared. A full ring drops the request, the
+// next draw of the mesh asks again.
+static void QueueMeshReupload(opengl *OpenGL, u32 Slot) {
+    opengl_mesh_stream *Stream = &OpenGL->MeshStream;
+    opengl_static_mesh *StaticMesh = OpenGL->StaticGeometry.Meshes + Slot;
+    if (!StaticMesh->ReuploadQueued &&
+            Stream->ReuploadWritePosition - Stream->ReuploadReadPosition < ArrayCount(Stream->ReuploadSlots)) {
+        Stream->ReuploadSlots[Stream->ReuploadWritePosition++ % ArrayCount(Stream->ReuploadSlots)] = Slot;
+        StaticMesh->ReuploadQueued = true;
+    }
+}
+
+static b32 PopMeshReupload(opengl *OpenGL, upload_work *Work) {
+    opengl_mesh_stream *Stream = &OpenGL->MeshStream;
+    while (Stream->ReuploadReadPosition != Stream->ReuploadWritePosition) {
+        u32 Slot = Stream->ReuploadSlots[Stream->ReuploadReadPosition++ % ArrayCount(Stream->ReuploadSlots)];
+        opengl_static_mesh *StaticMesh = OpenGL->StaticGeometry.Meshes + Slot;
+        if (StaticMesh->ReuploadQueued) {
+            StaticMesh->ReuploadQueued = false;
+            *Work = {};
+            Work->Operation = UPLOAD_OPERATION_CREATE;
+            Work->Slot = Slot;
+            Work->Mesh = StaticMesh->Source;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline void CompleteUploadWork(upload_work *Work) {
+    if (Work->Completed) {
+        PlatformAtomicExchange(Work->Completed, true);
     }
+}
+
+//
+// Mesh streaming
+//
+// Work comes off the queue in order until MESH_UPLOAD_BYTES_PER_FRAME
+// have been copied. The mesh that runs over the budget carries on
+// from where it stopped next frame, so a big mesh is spread over as
+// many frames as it needs and no frame copies much more than the
+// budget. Deletes cost nothing against it. Re-uploads of evicted meshes
+// are taken first, they're already being drawn.
+//
+static void StreamMeshUploads(opengl *OpenGL) {
+    opengl_static_geometry *Geometry = &OpenGL->StaticGeometry;
+    opengl_mesh_stream *Stream = &OpenGL->MeshStream;
+    size_t BudgetBytes = MESH_UPLOAD_BYTES_PER_FRAME;
+    for (;;) {
+        if (!Stream->Active) {
+            upload_work Work;
+            if (!PopMeshReupload(OpenGL, &Work) && !PopUploadWork(&OpenGL->UploadQueue, &Work)) {
+                break;
+            }
+            if (Work.Operation == UPLOAD_OPERATION_DELETE) {
+                OpenGLDeleteMesh(OpenGL, Work.Slot);
+                CompleteUploadWork(&Work);
+                continue;
+            }
+            Assert(Work.Operation == UPLOAD_OPERATION_CREATE);
+            if (!OpenGLCreateMesh(OpenGL, Work.Slot, Work.Mesh)) {
+                CompleteUploadWork(&Work);
+                continue;
+            }
+            Stream->Active = true;
+            Stream->Work = Work;
+            Stream->VerticesCopied = 0;
+            Stream->IndicesCopied = 0;
+        }
+
+        opengl_static_mesh *StaticMesh = Geometry->Meshes + Stream->Work.Slot;
+        u32 VertexCount = StaticMesh->VertexCount - Stream->VerticesCopied;
+        if (VertexCount > BudgetBytes/sizeof(vertex)) {
+            VertexCount = (u32)(BudgetBytes/sizeof(vertex));
+        }
+        BudgetBytes -= VertexCount*sizeof(vertex);
+        u32 IndexCount = 0;
+        if (Stream->VerticesCopied + VertexCount == StaticMesh->VertexCount) {
+            IndexCount = StaticMesh->IndexCount - Stream->IndicesCopied;
+            if (IndexCount > BudgetBytes/sizeof(u16)) {
+                IndexCount = (u32)(BudgetBytes/sizeof(u16));
+            }
+            BudgetBytes -= IndexCount*sizeof(u16);
+        }
+        CopyStaticMeshRange(Geometry, StaticMesh, Stream->VerticesCopied, VertexCount, Stream->IndicesCopied, IndexCount);
+        Stream->VerticesCopied += VertexCount;
+        Stream->IndicesCopied += IndexCount;
+
+        if (Stream->VerticesCopied < StaticMesh->VertexCount || Stream->IndicesCopied < StaticMesh->IndexCount) {
+            // Out of budget, the rest goes next frame
+            break;
+        }
+        StaticMesh->Streaming = false;
+        StaticMesh->Resident = true;
+        CompleteUploadWork(&Stream->Work);
+        Stream->Active = false;
+    }
+}
 
-    GLuint FragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(FragmentShader, 1, &FragmentShaderSource, 0);
-    glCompileShader(FragmentShader);
-    glGetShaderiv(FragmentShader, GL_COMPILE_STATUS, &Success);
+static void LogShaderStatus(GLuint Shader, char *Name) {
+    GLint Success = GL_FALSE;
+    glGetShaderiv(Shader, GL_COMPILE_STATUS, &Success);
     if (Success != GL_TRUE) {
         char Buffer[1024] = {};
-        glGetShaderInfoLog(FragmentShader, sizeof(Buffer), 0, Buffer);
-        LERROR("Fragment Shader: %s", Buffer);
+        glGetShaderInfoLog(Shader, sizeof(Buffer), 0, Buffer);
+        LERROR("%s: %s", Name, Buffer);
     }
+}
+
+// Queues both compiles and the link without checking anything, so the
+// driver is free to work on them in the background.
+static GLuint SubmitShaders(char *VertexShaderSource, char *FragmentShaderSource, GLuint *VertexShader, GLuint *FragmentShader) {
+    *VertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(*VertexShader, 1, &VertexShaderSource, 0);
+    glCompileShader(*VertexShader);
+
+    *FragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(*FragmentShader, 1, &FragmentShaderSource, 0);
+    glCompileShader(*FragmentShader);
 
     GLuint Program = glCreateProgram();
-    glAttachShader(Program, VertexShader);
-    glAttachShader(Program, FragmentShader);
+    glAttachShader(Program, *VertexShader);
+    glAttachShader(Program, *FragmentShader);
+    if (glProgramParameteri) {
+        glProgramParameteri(Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(Program);
+    return Program;
+}
+
+static b32 CheckProgram(GLuint Program, GLuint VertexShader, GLuint FragmentShader) {
+    GLint Success;
+    if (VertexShader) {
+        LogShaderStatus(VertexShader, "Vertex Shader");
+        LogShaderStatus(FragmentShader, "Fragment Shader");
+    }
+
     glGetProgramiv(Program, GL_LINK_STATUS, &Success);
-    if (Success != GL_TRUE) {
+    b32 Linked = (Success == GL_TRUE);
+    if (!Linked) {
         char Buffer[1024] = {};
         glGetProgramInfoLog(Program, sizeof(Buffer), 0, Buffer);
         LERROR("Program Link: %s", Buffer);
@@ -90,93 +375,550 @@ static GLuint CompileShader(char *VertexShaderSource, char *FragmentShaderSource
         LERROR("Program Validation: %s", Buffer);
     }
 
-    glDeleteShader(VertexShader);
-    glDeleteShader(FragmentShader);
+    if (VertexShader) {
+        glDeleteShader(VertexShader);
+        glDeleteShader(FragmentShader);
+    }
+    return Linked;
+}
 
+//
+// Program binary cache
+//
+// Linked programs are saved under SHADER_CACHE_DIR, named by a hash of
+// their sources and the driver's vendor, renderer and version strings.
+// A missing file, a header mismatch or a binary the driver rejects all
+// fall back to compiling from source, which then rewrites the entry.
+//
+static GLuint LoadCachedProgram(char *Path, u64 Key) {
+    GLuint Program = 0;
+    entire_file File = ReadEntireFile(Path, false);
+    if (File.Contents) {
+        program_cache_header *Header = (program_cache_header *)File.Contents;
+        if (File.Size >= sizeof(*Header) &&
+                Header->Magic == PROGRAM_CACHE_MAGIC &&
+                Header->Version == PROGRAM_CACHE_VERSION &&
+                Header->Key == Key &&
+                Header->Size == File.Size - sizeof(*Header)) {
+            Program = glCreateProgram();
+            glProgramBinary(Program, Header->Format, Header + 1, Header->Size);
+            GLint Success = GL_FALSE;
+            glGetProgramiv(Program, GL_LINK_STATUS, &Success);
+            if (Success != GL_TRUE) {
+                LINFO("Driver rejected cached program %s, recompiling.", Path);
+                glDeleteProgram(Program);
+                Program = 0;
+            }
+        }
+        FreeEntireFile(File);
+    }
     return Program;
 }
 
-static inline void CreateUnlitProgram(opengl *OpenGL) {
-    entire_file VertShaderFile = ReadEntireFile(SHADER_DIR "unlit_vert.glsl");
-    entire_file FragShaderFile = ReadEntireFile(SHADER_DIR "unlit_frag.glsl");
+static void SaveCachedProgram(GLuint Program, char *Path, u64 Key) {
+    GLint Linked = GL_FALSE;
+    glGetProgramiv(Program, GL_LINK_STATUS, &Linked);
+    GLint BinarySize = 0;
+    glGetProgramiv(Program, GL_PROGRAM_BINARY_LENGTH, &BinarySize);
+    if (Linked != GL_TRUE || BinarySize <= 0) {
+        return;
+    }
+
+    size_t FileSize = sizeof(program_cache_header) + BinarySize;
+    program_cache_header *Header = (program_cache_header *)malloc(FileSize);
+    GLenum Format = 0;
+    GLsizei Written = 0;
+    glGetProgramBinary(Program, BinarySize, &Written, &Format, Header + 1);
+    if (Written == BinarySize) {
+        Header->Magic = PROGRAM_CACHE_MAGIC;
+        Header->Version = PROGRAM_CACHE_VERSION;
+        Header->Key = Key;
+        Header->Format = Format;
+        Header->Size = (u32)BinarySize;
+        WriteEntireFile(Path, Header, FileSize);
+    }
+    free(Header);
+}
+
+static inline void GetProgramCachePath(char *Buffer, size_t BufferSize, u64 Key) {
+    snprintf(Buffer, BufferSize, SHADER_CACHE_DIR "%016llx.bin", (unsigned long long)Key);
+}
+
+//
+// Program batch
+//
+// Every program is submitted up front: cached binaries are handed to the
+// driver, everything else has its compiles and link queued. Nothing is
+// checked until FinishProgramBatch, which the first EndFrame calls, so the
+// driver's compiler threads overlap with asset loading. Setup then looks
+// up the uniforms once a program has linked.
+//
+static void SubmitProgram(opengl *OpenGL, opengl_shader_common *Common, char *VertexPath, char *FragmentPath, opengl_program_setup *Setup) {
+    opengl_program_batch *Batch = &OpenGL->ProgramBatch;
+    Assert(Batch->Count < ArrayCount(Batch->Programs));
+    opengl_pending_program *Pending = Batch->Programs + Batch->Count++;
+    *Pending = {};
+    Pending->Common = Common;
+    Pending->Setup = Setup;
+
+    entire_file VertShaderFile = ReadEntireFile(VertexPath);
+    entire_file FragShaderFile = ReadEntireFile(FragmentPath);
     Assert(VertShaderFile.Contents);
     Assert(FragShaderFile.Contents);
 
-    GLuint Handle = CompileShader(VertShaderFile.Contents, FragShaderFile.Contents);
-    OpenGL->UnlitProgram.Common.Handle = Handle;
+    u64 Key = HashFNV1a(VertShaderFile.Contents, VertShaderFile.Size, OpenGL->DriverHash);
+    Key = HashFNV1a(FragShaderFile.Contents, FragShaderFile.Size, Key);
+    Pending->Key = Key;
+
+    GLuint Handle = 0;
+    if (OpenGL->UseProgramCache) {
+        char CachePath[256];
+        GetProgramCachePath(CachePath, sizeof(CachePath), Key);
+        Handle = LoadCachedProgram(CachePath, Key);
+    }
+    if (Handle) {
+        ++Batch->CachedCount;
+    }
+    else {
+        Handle = SubmitShaders(VertShaderFile.Contents, FragShaderFile.Contents,
+                &Pending->VertexShader, &Pending->FragmentShader);
+    }
+    Common->Handle = Handle;
+
     FreeEntireFile(VertShaderFile);
     FreeEntireFile(FragShaderFile);
+}
 
-    glUseProgram(Handle);
-    glBindAttribLocation(Handle, 0, "_Position");
-    glBindAttribLocation(Handle, 1, "_Color");
+static void FinishProgramBatch(opengl *OpenGL) {
+    opengl_program_batch *Batch = &OpenGL->ProgramBatch;
+    f64 BeginSeconds = PlatformGetSeconds();
+
+    // With parallel compile, poll so the links are collected in whatever
+    // order they finish. Without it the link status query below blocks.
+    if (OpenGL->HasParallelShaderCompile) {
+        for (;;) {
+            b32 AllDone = true;
+            for (u32 i = 0; i < Batch->Count; ++i) {
+                GLint Done = GL_TRUE;
+                glGetProgramiv(Batch->Programs[i].Common->Handle, GL_COMPLETION_STATUS_KHR, &Done);
+                if (!Done) {
+                    AllDone = false;
+                }
+            }
+            if (AllDone) {
+                break;
+            }
+            PlatformSleep(1);
+        }
+    }
 
-    OpenGL->UnlitProgram.Transform = glGetUniformLocation(Handle, "Transform");
+    for (u32 i = 0; i < Batch->Count; ++i) {
+        opengl_pending_program *Pending = Batch->Programs + i;
+        GLuint Handle = Pending->Common->Handle;
+        b32 Compiled = (Pending->VertexShader != 0);
+        b32 Linked = CheckProgram(Handle, Pending->VertexShader, Pending->FragmentShader);
+        if (Compiled && Linked && OpenGL->UseProgramCache) {
+            char CachePath[256];
+            GetProgramCachePath(CachePath, sizeof(CachePath), Pending->Key);
+            SaveCachedProgram(Handle, CachePath, Pending->Key);
+        }
 
-    glUseProgram(0);
+        glUseProgram(Handle);
+        Pending->Setup(OpenGL, Pending->Common);
+        glUseProgram(0);
+    }
+
+    OpenGL->StartupTimings.ShaderWaitSeconds = PlatformGetSeconds() - BeginSeconds;
+    LINFO("Programs: %u (%u cached), submit %.2fms, wait %.2fms.", Batch->Count, Batch->CachedCount,
+            1000.0*OpenGL->StartupTimings.ShaderSubmitSeconds, 1000.0*OpenGL->StartupTimings.ShaderWaitSeconds);
+    Batch->Count = 0;
 }
 
-static inline void CreateCircleProgram(opengl *OpenGL) {
-    entire_file VertShaderFile = ReadEntireFile(SHADER_DIR "circle_vert.glsl");
-    entire_file FragShaderFile = ReadEntireFile(SHADER_DIR "circle_frag.glsl");
-    Assert(VertShaderFile.Contents);
-    Assert(FragShaderFile.Contents);
+static void SetupUnlitProgram(opengl *OpenGL, opengl_shader_common *Common) {
+    OpenGL->UnlitProgram.Transform = glGetUniformLocation(Common->Handle, "Transform");
+}
 
-    GLuint Handle = CompileShader(VertShaderFile.Contents, FragShaderFile.Contents);
-    OpenGL->CircleProgram.Common.Handle = Handle;
-    FreeEntireFile(VertShaderFile);
-    FreeEntireFile(FragShaderFile);
+static void SetupCircleProgram(opengl *OpenGL, opengl_shader_common *Common) {
+    OpenGL->CircleProgram.Transform = glGetUniformLocation(Common->Handle, "Transform");
+    OpenGL->CircleProgram.Radius = glGetUniformLocation(Common->Handle, "Radius");
+}
 
-    glUseProgram(Handle);
-    glBindAttribLocation(Handle, 0, "_Position");
-    glBindAttribLocation(Handle, 1, "_Color");
-    glBindAttribLocation(Handle, 2, "_UV");
+static void SetupRetainedCircleProgram(opengl *OpenGL, opengl_shader_common *Common) {
+    GLuint Handle = Common->Handle;
+    OpenGL->RetainedCircleProgram.Transform = glGetUniformLocation(Handle, "Transform");
+    OpenGL->RetainedCircleProgram.Radius = glGetUniformLocation(Handle, "Radius");
+    OpenGL->RetainedCircleProgram.Time = glGetUniformLocation(Handle, "Time");
+    OpenGL->RetainedCircleProgram.Speed = glGetUniformLocation(Handle, "Speed");
+    OpenGL->RetainedCircleProgram.HotIndex = glGetUniformLocation(Handle, "HotIndex");
+}
 
-    OpenGL->CircleProgram.Transform = glGetUniformLocation(Handle, "Transform");
-    OpenGL->CircleProgram.Radius = glGetUniformLocation(Handle, "Radius");
+static void SetupDebugProgram(opengl *OpenGL, opengl_shader_common *Common) {
+    OpenGL->DebugProgram.Transform = glGetUniformLocation(Common->Handle, "Transform");
+}
 
-    glUseProgram(0);
+static void SetupResolveProgram(opengl *OpenGL, opengl_shader_common *Common) {
+    OpenGL->ResolveProgram.UVScale = glGetUniformLocation(Common->Handle, "UVScale");
 }
 
-static inline void CreateDebugProgram(opengl *OpenGL) {
-    entire_file VertShaderFile = ReadEntireFile(SHADER_DIR "debug_vert.glsl");
-    entire_file FragShaderFile = ReadEntireFile(SHADER_DIR "debug_frag.glsl");
-    Assert(VertShaderFile.Contents);
-    Assert(FragShaderFile.Contents);
+static void SetupOpaqueCircleProgram(opengl *OpenGL, opengl_shader_common *Common) {
+    OpenGL->OpaqueCircleProgram.Transform = glGetUniformLocation(Common->Handle, "Transform");
+}
 
-    GLuint Handle = CompileShader(VertShaderFile.Contents, FragShaderFile.Contents);
-    OpenGL->DebugProgram.Common.Handle = Handle;
-    FreeEntireFile(VertShaderFile);
-    FreeEntireFile(FragShaderFile);
+static void SetupOITCircleProgram(opengl *OpenGL, opengl_shader_common *Common) {
+    OpenGL->OITCircleProgram.Transform = glGetUniformLocation(Common->Handle, "Transform");
+}
 
-    glUseProgram(Handle);
-    glBindAttribLocation(Handle, 0, "_Position");
-    glBindAttribLocation(Handle, 1, "_Color");
+// Shared by the single and multisampled composite programs
+static void SetupOITCompositeProgram(opengl *OpenGL, opengl_shader_common *Common) {
+    opengl_oit_composite_program *Program = (opengl_oit_composite_program *)Common;
+    Program->Accumulation = glGetUniformLocation(Common->Handle, "Accumulation");
+    Program->Revealage = glGetUniformLocation(Common->Handle, "Revealage");
+    glUniform1i(Program->Accumulation, 0);
+    glUniform1i(Program->Revealage, 1);
+}
 
-    OpenGL->DebugProgram.Transform = glGetUniformLocation(Handle, "Transform");
+static b32 HasExtension(const char *Name) {
+    GLint ExtensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &ExtensionCount);
+    for (GLint i = 0; i < ExtensionCount; ++i) {
+        const char *Extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (Extension && strcmp(Extension, Name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    glUseProgram(0);
+//
+// Render targets
+//
+static void DestroyRenderTarget(opengl_render_target *Target) {
+    if (Target->FBO) {
+        glDeleteFramebuffers(1, &Target->FBO);
+        glDeleteTextures(1, &Target->Color);
+        if (Target->ObjectIDs) {
+            glDeleteTextures(1, &Target->ObjectIDs);
+        }
+        if (Target->Depth) {
+            glDeleteRenderbuffers(1, &Target->Depth);
+        }
+    }
+    *Target = {};
 }
 
-static inline void CreateResolveProgram(opengl *OpenGL) {
-    entire_file VertShaderFile = ReadEntireFile(SHADER_DIR "resolve_vert.glsl");
-    entire_file FragShaderFile = ReadEntireFile(SHADER_DIR "resolve_frag.glsl");
-    Assert(VertShaderFile.Contents);
-    Assert(FragShaderFile.Contents);
+static void CreateRenderTarget(opengl_render_target *Target, u32 Width, u32 Height, u32 Samples, b32 HasDepth, b32 HasObjectIDs) {
+    Target->Width = Width;
+    Target->Height = Height;
+    Target->Samples = Samples;
+    Target->HasDepth = HasDepth;
+    Target->HasObjectIDs = HasObjectIDs;
+
+    glGenFramebuffers(1, &Target->FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, Target->FBO);
+
+    glGenTextures(1, &Target->Color);
+    if (Samples > 1) {
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, Target->Color);
+        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, Samples, GL_RGBA8, Width, Height, GL_TRUE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, Target->Color, 0);
+    }
+    else {
+        glBindTexture(GL_TEXTURE_2D, Target->Color);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, Width, Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, Target->Color, 0);
+    }
 
-    GLuint Handle = CompileShader(VertShaderFile.Contents, FragShaderFile.Contents);
-    OpenGL->ResolveProgram.Common.Handle = Handle;
-    FreeEntireFile(VertShaderFile);
-    FreeEntireFile(FragShaderFile);
+    // Integer IDs are never filtered, a resolve keeps one sample's ID
+    if (HasObjectIDs) {
+        glGenTextures(1, &Target->ObjectIDs);
+        if (Samples > 1) {
+            glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, Target->ObjectIDs);
+            glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, Samples, GL_R32UI, Width, Height, GL_TRUE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D_MULTISAMPLE, Target->ObjectIDs, 0);
+        }
+        else {
+            glBindTexture(GL_TEXTURE_2D, Target->ObjectIDs);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, Width, Height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, Target->ObjectIDs, 0);
+        }
+        GLenum DrawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(ArrayCount(DrawBuffers), DrawBuffers);
+    }
 
-    glUseProgram(Handle);
-    glBindAttribLocation(Handle, 0, "_Position");
-    glBindAttribLocation(Handle, 1, "_UV");
+    if (HasDepth) {
+        glGenRenderbuffers(1, &Target->Depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, Target->Depth);
+        if (Samples > 1) {
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, Samples, GL_DEPTH_COMPONENT24, Width, Height);
+        }
+        else {
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, Width, Height);
+        }
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, Target->Depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    }
 
-    glUseProgram(0);
+    GLenum Status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (Status != GL_FRAMEBUFFER_COMPLETE) {
+        LERROR("Framebuffer incomplete: 0x%x", Status);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Hands out a free pooled target matching the description. Otherwise a
+// free slot is (re)allocated; idle targets of another description are
+// recycled before the pool is considered full.
+static opengl_render_target *AcquireRenderTarget(opengl *OpenGL, u32 Width, u32 Height, u32 Samples, b32 HasDepth, b32 HasObjectIDs) {
+    opengl_render_target *Empty = 0;
+    opengl_render_target *Idle = 0;
+    for (u32 i = 0; i < MAX_RENDER_TARGET_COUNT; ++i) {
+        opengl_render_target *Target = &OpenGL->RenderTargets[i];
+        if (Target->InUse) {
+            continue;
+        }
+        if (!Target->FBO) {
+            if (!Empty) Empty = Target;
+            continue;
+        }
+        if (Target->Width == Width && Target->Height == Height &&
+                Target->Samples == Samples && Target->HasDepth == HasDepth &&
+                Target->HasObjectIDs == HasObjectIDs) {
+            Target->InUse = true;
+            return Target;
+        }
+        if (!Idle) Idle = Target;
+    }
+
+    opengl_render_target *Result = Empty ? Empty : Idle;
+    Assert(Result);
+    DestroyRenderTarget(Result);
+    CreateRenderTarget(Result, Width, Height, Samples, HasDepth, HasObjectIDs);
+    Result->InUse = true;
+    return Result;
+}
+
+static void ReleaseRenderTarget(opengl_render_target *Target) {
+    Target->InUse = false;
+}
+
+// Tells the driver the contents are no longer needed, so tiled and
+// software implementations can skip writing them back to memory.
+static void InvalidateRenderTarget(opengl_render_target *Target, b32 Color, b32 Depth) {
+    GLenum Attachments[3];
+    GLsizei AttachmentCount = 0;
+    if (Color) {
+        Attachments[AttachmentCount++] = GL_COLOR_ATTACHMENT0;
+        if (Target->HasObjectIDs) {
+            Attachments[AttachmentCount++] = GL_COLOR_ATTACHMENT1;
+        }
+    }
+    if (Depth && Target->HasDepth) {
+        Attachments[AttachmentCount++] = GL_DEPTH_ATTACHMENT;
+    }
+    if (AttachmentCount) {
+        glBindFramebuffer(GL_FRAMEBUFFER, Target->FBO);
+        glInvalidateFramebuffer(GL_FRAMEBUFFER, AttachmentCount, Attachments);
+    }
+}
+
+//
+// Weighted blended OIT targets
+//
+static void DestroyOITTarget(opengl *OpenGL) {
+    opengl_oit_target *Target = &OpenGL->OITTarget;
+    if (Target->FBO) {
+        glDeleteFramebuffers(1, &Target->FBO);
+        glDeleteTextures(1, &Target->Accumulation);
+        glDeleteTextures(1, &Target->Revealage);
+    }
+    *Target = {};
+}
+
+static void CreateOITAttachment(GLuint Texture, GLenum Attachment, u32 Samples, GLenum Format, GLenum PixelFormat) {
+    if (Samples > 1) {
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, Texture);
+        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, Samples, Format, TARGET_WIDTH, TARGET_HEIGHT, GL_TRUE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, Attachment, GL_TEXTURE_2D_MULTISAMPLE, Texture, 0);
+    }
+    else {
+        glBindTexture(GL_TEXTURE_2D, Texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, Format, TARGET_WIDTH, TARGET_HEIGHT, 0, PixelFormat, GL_FLOAT, NULL);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, Attachment, GL_TEXTURE_2D, Texture, 0);
+    }
+}
+
+static void CreateOITTarget(opengl *OpenGL) {
+    DestroyOITTarget(OpenGL);
+    opengl_render_target *Scene = OpenGL->SceneTarget;
+    opengl_oit_target *Target = &OpenGL->OITTarget;
+    Target->Samples = Scene->Samples;
+
+    glGenFramebuffers(1, &Target->FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, Target->FBO);
+    glGenTextures(1, &Target->Accumulation);
+    glGenTextures(1, &Target->Revealage);
+    CreateOITAttachment(Target->Accumulation, GL_COLOR_ATTACHMENT0, Target->Samples, GL_RGBA16F, GL_RGBA);
+    CreateOITAttachment(Target->Revealage, GL_COLOR_ATTACHMENT1, Target->Samples, GL_R16F, GL_RED);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, Scene->Depth);
+
+    GLenum DrawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(ArrayCount(DrawBuffers), DrawBuffers);
+
+    GLenum Status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (Status != GL_FRAMEBUFFER_COMPLETE) {
+        LERROR("OIT framebuffer incomplete: 0x%x", Status);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, Scene->FBO);
+}
+
+// Valid counts are 1, 2, 4, 8 and 16, clamped to what the driver supports.
+// A count of 1 skips multisampling entirely and uses plain attachments.
+static void CreateSceneTarget(opengl *OpenGL, u32 SampleCount) {
+    GLint MaxSamples = 1;
+    glGetIntegerv(GL_MAX_SAMPLES, &MaxSamples);
+    u32 Samples = 1;
+    while (Samples*2 <= SampleCount && Samples*2 <= (u32)MaxSamples && Samples < 16) {
+        Samples *= 2;
+    }
+    if (Samples != SampleCount) {
+        LWARN("Requested %u samples, using %u.", SampleCount, Samples);
+    }
+
+    opengl_render_target *OldTarget = OpenGL->SceneTarget;
+    if (OldTarget) {
+        ReleaseRenderTarget(OldTarget);
+    }
+    // The OIT target borrows the scene's depth, it's rebuilt on next use
+    DestroyOITTarget(OpenGL);
+    OpenGL->RequestedSampleCount = SampleCount;
+    OpenGL->SampleCount = Samples;
+    OpenGL->SceneTarget = AcquireRenderTarget(OpenGL, TARGET_WIDTH, TARGET_HEIGHT, Samples, true, true);
+    // Nothing else asks for a multisampled target, so the old one would
+    // otherwise sit idle in the pool at full size
+    if (OldTarget && OldTarget != OpenGL->SceneTarget && !OldTarget->InUse) {
+        DestroyRenderTarget(OldTarget);
+    }
+    LINFO("Render target using %u sample(s).", Samples);
+}
+
+//
+// Object ID picking
+//
+static void InitPickReadback(opengl *OpenGL) {
+    opengl_pick_readback *Readback = &OpenGL->PickReadback;
+    Readback->Enabled = (glFenceSync && glClientWaitSync && glDeleteSync && glGetBufferSubData);
+    if (!Readback->Enabled) {
+        LINFO("Fences or buffer reads not available, GPU picking disabled.");
+        return;
+    }
+
+    glGenTextures(1, &Readback->Texture);
+    glBindTexture(GL_TEXTURE_2D, Readback->Texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, 1, 1, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &Readback->FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, Readback->FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, Readback->Texture, 0);
+    GLenum Status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (Status != GL_FRAMEBUFFER_COMPLETE) {
+        LERROR("Pick framebuffer incomplete: 0x%x", Status);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(PICK_READBACK_SLOT_COUNT, Readback->Buffers);
+    for (u32 i = 0; i < PICK_READBACK_SLOT_COUNT; ++i) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, Readback->Buffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(u32), 0, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Takes the newest finished readback. Slots finish in the order they
+// were issued, so the scan stops at the first one still in flight.
+static void PollPickReadback(opengl *OpenGL) {
+    opengl_pick_readback *Readback = &OpenGL->PickReadback;
+    if (!Readback->Enabled) {
+        return;
+    }
+
+    for (u32 i = 0; i < PICK_READBACK_SLOT_COUNT; ++i) {
+        u32 Slot = (Readback->SlotIndex + i) % PICK_READBACK_SLOT_COUNT;
+        GLsync Fence = Readback->Fences[Slot];
+        if (!Fence) {
+            continue;
+        }
+        GLenum Result = glClientWaitSync(Fence, 0, 0);
+        if (Result != GL_ALREADY_SIGNALED && Result != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, Readback->Buffers[Slot]);
+        glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(u32), &Readback->ObjectID);
+        glDeleteSync(Fence);
+        Readback->Fences[Slot] = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Runs at the end of the scene pass, before the resolve invalidates the
+// IDs. The multisampled pixel resolves to one of its samples' IDs.
+static void IssuePickReadback(opengl *OpenGL) {
+    opengl_pick_readback *Readback = &OpenGL->PickReadback;
+    opengl_render_target *Scene = OpenGL->SceneTarget;
+    if (!Readback->Enabled || !Scene->HasObjectIDs) {
+        return;
+    }
+
+    // The scene fills the window at the render size, with y up
+    f32 X = (GlobalMouseP.x + 0.5f)*OpenGL->RenderWidth/GlobalScreenWidth;
+    f32 Y = (GlobalScreenHeight - GlobalMouseP.y - 0.5f)*OpenGL->RenderHeight/GlobalScreenHeight;
+    if (X < 0.f || Y < 0.f || X >= (f32)OpenGL->RenderWidth || Y >= (f32)OpenGL->RenderHeight) {
+        // Anything still in flight is from before the mouse left
+        for (u32 i = 0; i < PICK_READBACK_SLOT_COUNT; ++i) {
+            if (Readback->Fences[i]) {
+                glDeleteSync(Readback->Fences[i]);
+                Readback->Fences[i] = 0;
+            }
+        }
+        Readback->ObjectID = OBJECT_ID_NONE;
+        return;
+    }
+
+    // The GPU is a whole ring behind, skip a frame rather than reuse a
+    // buffer it may still be writing
+    u32 Slot = Readback->SlotIndex;
+    if (Readback->Fences[Slot]) {
+        return;
+    }
+
+    GLint PixelX = (GLint)X;
+    GLint PixelY = (GLint)Y;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, Scene->FBO);
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, Readback->FBO);
+    glBlitFramebuffer(PixelX, PixelY, PixelX + 1, PixelY + 1, 0, 0, 1, 1, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, Readback->FBO);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, Readback->Buffers[Slot]);
+    glReadPixels(0, 0, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    Readback->Fences[Slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    Readback->SlotIndex = (Slot + 1) % PICK_READBACK_SLOT_COUNT;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, Scene->FBO);
 }
 
 static void InitOpenGL(opengl *OpenGL) {
+    f64 InitBeginSeconds = PlatformGetSeconds();
     glDebugMessageCallback(DebugCallback, NULL);
     glEnable(GL_DEBUG_OUTPUT);
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
@@ -187,41 +929,13 @@ static void InitOpenGL(opengl *OpenGL) {
     glCullFace(GL_BACK);
     glFrontFace(GL_CCW);
 
+    InitUploadQueue(&OpenGL->UploadQueue);
+    OpenGL->MeshStream = {};
+
     //
-    // Multisample setup
+    // Render target setup
     //
-    glGenFramebuffers(1, &OpenGL->MultisampledFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, OpenGL->MultisampledFBO);
-
-    glGenTextures(1, &OpenGL->MultisampledTexture);
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, OpenGL->MultisampledTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 16, GL_RGBA8, TARGET_WIDTH, TARGET_HEIGHT, GL_TRUE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, OpenGL->MultisampledTexture, 0);
-
-    glGenRenderbuffers(1, &OpenGL->DepthRBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, OpenGL->DepthRBO);
-    glRenderbufferStorageMultisample(GL_RENDERBUFFER, 16, GL_DEPTH_COMPONENT24, TARGET_WIDTH, TARGET_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, OpenGL->DepthRBO);
-    GLenum Status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if (Status != GL_FRAMEBUFFER_COMPLETE) {
-        LERROR("Framebuffer incomplete: 0x%x", Status);
-    }
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-
-    glGenFramebuffers(1, &OpenGL->ResolveFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, OpenGL->ResolveFBO);
-    glGenTextures(1, &OpenGL->ResolveTexture);
-    glBindTexture(GL_TEXTURE_2D, OpenGL->ResolveTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, TARGET_WIDTH, TARGET_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, OpenGL->ResolveTexture, 0);
-    Status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if (Status != GL_FRAMEBUFFER_COMPLETE) {
-        LERROR("Framebuffer incomplete: 0x%x", Status);
-    }
+    CreateSceneTarget(OpenGL, DEFAULT_MSAA_SAMPLE_COUNT);
 
     f32 QuadVertices[] = {
         // Positions   // TexCoords
@@ -264,9 +978,9 @@ static void InitOpenGL(opengl *OpenGL) {
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(line_vertex), (void *)(offsetof(line_vertex, Position)));
         glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(line_vertex), (void *)(offsetof(line_vertex, Color)));
 
-        OpenGL->Meshes[MESH_INDEX_LINE_PUSH_BUFFER].VAO = VAO;
-        OpenGL->Meshes[MESH_INDEX_LINE_PUSH_BUFFER].VBO = VBO;
-        OpenGL->Meshes[MESH_INDEX_LINE_PUSH_BUFFER].IBO = IBO;
+        OpenGL->LinePushBuffer.VAO = VAO;
+        OpenGL->LinePushBuffer.VBO = VBO;
+        OpenGL->LinePushBuffer.IBO = IBO;
     }
 
     //
@@ -287,36 +1001,274 @@ static void InitOpenGL(opengl *OpenGL) {
         glEnableVertexAttribArray(1);
         glEnableVertexAttribArray(2);
 
+        // Every quad uses the same 0,1,2,2,3,0 pattern, so the index
+        // buffer is built once here and never touched again.
+        size_t QuadIndicesSize = 6*MAX_QUAD_COUNT*sizeof(u32);
+        u32 *QuadIndices = (u32 *)malloc(QuadIndicesSize);
+        Assert(QuadIndices);
+        for (u32 i = 0; i < MAX_QUAD_COUNT; ++i) {
+            QuadIndices[i*6 + 0] = i*4 + 0;
+            QuadIndices[i*6 + 1] = i*4 + 1;
+            QuadIndices[i*6 + 2] = i*4 + 2;
+            QuadIndices[i*6 + 3] = i*4 + 2;
+            QuadIndices[i*6 + 4] = i*4 + 3;
+            QuadIndices[i*6 + 5] = i*4 + 0;
+        }
+
         glBufferData(GL_ARRAY_BUFFER, sizeof(OpenGL->QuadVertexPushBufferData), 0, GL_STREAM_DRAW);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(OpenGL->QuadIndexPushBufferData), 0, GL_STREAM_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, QuadIndicesSize, QuadIndices, GL_STATIC_DRAW);
+        free(QuadIndices);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)(offsetof(vertex, Position)));
         glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)(offsetof(vertex, Color)));
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)(offsetof(vertex, UV)));
 
-        OpenGL->Meshes[MESH_INDEX_QUAD_PUSH_BUFFER].VAO = VAO;
-        OpenGL->Meshes[MESH_INDEX_QUAD_PUSH_BUFFER].VBO = VBO;
-        OpenGL->Meshes[MESH_INDEX_QUAD_PUSH_BUFFER].IBO = IBO;
+        glGenBuffers(1, &OpenGL->QuadObjectIDBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, OpenGL->QuadObjectIDBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(OpenGL->QuadObjectIDPushBufferData), 0, GL_STREAM_DRAW);
+        glEnableVertexAttribArray(3);
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(u32), (void *)0);
+
+        OpenGL->QuadPushBuffer.VAO = VAO;
+        OpenGL->QuadPushBuffer.VBO = VBO;
+        OpenGL->QuadPushBuffer.IBO = IBO;
+    }
+
+    //
+    // Static geometry setup
+    //
+    {
+        opengl_static_geometry *Geometry = &OpenGL->StaticGeometry;
+        glGenVertexArrays(1, &Geometry->VAO);
+        glGenBuffers(1, &Geometry->VBO);
+        glGenBuffers(1, &Geometry->IBO);
+
+        glBindVertexArray(Geometry->VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, Geometry->VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Geometry->IBO);
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+
+        glBufferData(GL_ARRAY_BUFFER, STATIC_VERTEX_CAPACITY*sizeof(vertex), 0, GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, STATIC_INDEX_CAPACITY*sizeof(u16), 0, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)(offsetof(vertex, Position)));
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)(offsetof(vertex, Color)));
+
+        u32 ObjectIDs[MAX_MESH_COUNT + 1];
+        ObjectIDs[0] = OBJECT_ID_NONE;
+        for (u32 i = 0; i < MAX_MESH_COUNT; ++i) {
+            ObjectIDs[i + 1] = MESH_OBJECT_ID(i);
+        }
+        glGenBuffers(1, &Geometry->ObjectIDBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, Geometry->ObjectIDBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(ObjectIDs), ObjectIDs, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+        glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(u32), (void *)0);
+
+        InitBufferAllocator(&Geometry->VertexAllocator, STATIC_VERTEX_CAPACITY);
+        InitBufferAllocator(&Geometry->IndexAllocator, STATIC_INDEX_CAPACITY);
+        Geometry->BudgetBytes = DEFAULT_MESH_BUDGET_BYTES;
+        // Starts at one so a fresh upload can be marked as used the frame before
+        Geometry->FrameIndex = 1;
+    }
+
+    //
+    // Retained circle buffer setup
+    //
+    {
+        glGenVertexArrays(1, &OpenGL->CircleRecordVAO);
+        glGenBuffers(1, &OpenGL->CircleRecordBuffer);
+
+        glBindVertexArray(OpenGL->CircleRecordVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, OpenGL->CircleRecordBuffer);
+        glBufferData(GL_ARRAY_BUFFER, MAX_CIRCLE_COUNT*sizeof(circle_record), 0, GL_DYNAMIC_DRAW);
+
+        for (u32 i = 0; i < 5; ++i) {
+            glEnableVertexAttribArray(i);
+            glVertexAttribDivisor(i, 1);
+        }
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(circle_record), (void *)(offsetof(circle_record, Color)));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(circle_record), (void *)(offsetof(circle_record, StartPosition)));
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(circle_record), (void *)(offsetof(circle_record, SpawnTime)));
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(circle_record), (void *)(offsetof(circle_record, Velocity)));
+        glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(circle_record), (void *)(offsetof(circle_record, Radius)));
+    }
+
+    //
+    // Circle instance buffer setup
+    //
+    {
+        glGenVertexArrays(1, &OpenGL->CircleInstanceVAO);
+        glGenBuffers(1, &OpenGL->CircleInstanceBuffer);
+
+        glBindVertexArray(OpenGL->CircleInstanceVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, OpenGL->CircleInstanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, MAX_CIRCLE_COUNT*sizeof(circle_instance), 0, GL_STREAM_DRAW);
+
+        for (u32 i = 0; i < 4; ++i) {
+            glEnableVertexAttribArray(i);
+            glVertexAttribDivisor(i, 1);
+        }
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void *)(offsetof(circle_instance, Color)));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void *)(offsetof(circle_instance, Position)));
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(circle_instance), (void *)(offsetof(circle_instance, Radius)));
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(circle_instance), (void *)(offsetof(circle_instance, ObjectID)));
+    }
+
+    //
+    // Pipeline statistics
+    //
+    OpenGL->HasPipelineStatistics = (glGetStringi && glGenQueries &&
+            HasExtension("GL_ARB_pipeline_statistics_query"));
+    if (OpenGL->HasPipelineStatistics) {
+        glGenQueries(ArrayCount(OpenGL->FragmentQueries), OpenGL->FragmentQueries);
+    }
+    else {
+        LINFO("Pipeline statistics queries not available, fragment counts disabled.");
+    }
+
+    //
+    // GPU timers
+    //
+    OpenGL->GPUTimers.Enabled = (glGenQueries && glQueryCounter);
+    if (OpenGL->GPUTimers.Enabled) {
+        glGenQueries(sizeof(OpenGL->GPUTimers.Queries)/sizeof(GLuint), &OpenGL->GPUTimers.Queries[0][0]);
+    }
+    else {
+        LINFO("Timestamp queries not available, GPU timings disabled.");
     }
 
+    //
+    // Object ID readback
+    //
+    InitPickReadback(OpenGL);
+
+    //
+    // Indirect draw setup
+    //
+    OpenGL->UseIndirectDraws = (glMultiDrawElementsIndirect != NULL);
+    if (OpenGL->UseIndirectDraws) {
+        glGenBuffers(1, &OpenGL->IndirectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, OpenGL->IndirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(OpenGL->LineIndirectCommands) + sizeof(OpenGL->QuadIndirectCommands) + sizeof(OpenGL->MeshIndirectCommands), 0, GL_STREAM_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else {
+        LINFO("glMultiDrawElementsIndirect not available, falling back to one draw per group.");
+    }
+
+    OpenGL->DynamicResolution.Enabled = true;
+    OpenGL->DynamicResolution.Scale = 1.f;
+    OpenGL->DynamicResolution.BudgetMs = 1000.f/60.f;
+
     //
     // Create shader programs
     //
-    CreateDebugProgram(OpenGL);
-    CreateUnlitProgram(OpenGL);
-    CreateResolveProgram(OpenGL);
-    CreateCircleProgram(OpenGL);
+    GLint BinaryFormatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &BinaryFormatCount);
+    OpenGL->UseProgramCache = (BinaryFormatCount > 0 &&
+            glProgramBinary && glGetProgramBinary && glProgramParameteri &&
+            PlatformCreateDirectory(SHADER_CACHE_DIR));
+    if (!OpenGL->UseProgramCache) {
+        LINFO("Program binaries not available, shaders compile from source.");
+    }
+    OpenGL->DriverHash = HashString((const char *)glGetString(GL_VENDOR));
+    OpenGL->DriverHash = HashString((const char *)glGetString(GL_RENDERER), OpenGL->DriverHash);
+    OpenGL->DriverHash = HashString((const char *)glGetString(GL_VERSION), OpenGL->DriverHash);
+
+    OpenGL->HasParallelShaderCompile = (glMaxShaderCompilerThreadsKHR &&
+            (HasExtension("GL_KHR_parallel_shader_compile") || HasExtension("GL_ARB_parallel_shader_compile")));
+    if (OpenGL->HasParallelShaderCompile) {
+        // Let the driver pick how many compiler threads to use
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+
+    f64 SubmitBeginSeconds = PlatformGetSeconds();
+    SubmitProgram(OpenGL, &OpenGL->DebugProgram.Common, SHADER_DIR "debug_vert.glsl", SHADER_DIR "debug_frag.glsl", SetupDebugProgram);
+    SubmitProgram(OpenGL, &OpenGL->UnlitProgram.Common, SHADER_DIR "unlit_vert.glsl", SHADER_DIR "unlit_frag.glsl", SetupUnlitProgram);
+    SubmitProgram(OpenGL, &OpenGL->ResolveProgram.Common, SHADER_DIR "resolve_vert.glsl", SHADER_DIR "resolve_frag.glsl", SetupResolveProgram);
+    SubmitProgram(OpenGL, &OpenGL->CircleProgram.Common, SHADER_DIR "circle_vert.glsl", SHADER_DIR "circle_frag.glsl", SetupCircleProgram);
+    SubmitProgram(OpenGL, &OpenGL->RetainedCircleProgram.Common, SHADER_DIR "circle_retained_vert.glsl", SHADER_DIR "circle_frag.glsl", SetupRetainedCircleProgram);
+    SubmitProgram(OpenGL, &OpenGL->OpaqueCircleProgram.Common, SHADER_DIR "circle_instance_vert.glsl", SHADER_DIR "circle_opaque_frag.glsl", SetupOpaqueCircleProgram);
+    SubmitProgram(OpenGL, &OpenGL->OITCircleProgram.Common, SHADER_DIR "circle_instance_vert.glsl", SHADER_DIR "circle_oit_frag.glsl", SetupOITCircleProgram);
+    SubmitProgram(OpenGL, &OpenGL->OITCompositeProgram.Common, SHADER_DIR "resolve_vert.glsl", SHADER_DIR "oit_composite_frag.glsl", SetupOITCompositeProgram);
+    SubmitProgram(OpenGL, &OpenGL->OITCompositeMSProgram.Common, SHADER_DIR "resolve_vert.glsl", SHADER_DIR "oit_composite_ms_frag.glsl", SetupOITCompositeProgram);
+    OpenGL->StartupTimings.ShaderSubmitSeconds = PlatformGetSeconds() - SubmitBeginSeconds;
 
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+    // Program submission is included, the compiles finish in the first EndFrame
+    OpenGL->StartupTimings.InitSeconds = PlatformGetSeconds() - InitBeginSeconds;
+    LINFO("OpenGL init: %.2fms, %u programs submitted%s.", 1000.0*OpenGL->StartupTimings.InitSeconds,
+            OpenGL->ProgramBatch.Count, OpenGL->HasParallelShaderCompile ? " for parallel compile" : "");
+}
+
+//
+// Dynamic resolution
+//
+
+// FrameSeconds is how long the last frame was busy on the slower of the
+// CPU and GPU, not counting the wait on vsync.
+static void UpdateDynamicResolution(opengl *OpenGL, f64 FrameSeconds) {
+    dynamic_resolution *Resolution = &OpenGL->DynamicResolution;
+    if (!Resolution->Enabled) {
+        Resolution->Scale = 1.f;
+        return;
+    }
+
+    f32 FrameMs = (f32)(1000.0*FrameSeconds);
+    Resolution->FilteredFrameMs += 0.1f*(FrameMs - Resolution->FilteredFrameMs);
+
+    if (Resolution->FilteredFrameMs > 1.05f*Resolution->BudgetMs) {
+        Resolution->UnderBudgetFrames = 0;
+        if (++Resolution->OverBudgetFrames >= DYNAMIC_RESOLUTION_DOWN_FRAMES) {
+            Resolution->OverBudgetFrames = 0;
+            Resolution->Scale -= DYNAMIC_RESOLUTION_DOWN_STEP;
+        }
+    }
+    else if (Resolution->FilteredFrameMs < 0.8f*Resolution->BudgetMs) {
+        Resolution->OverBudgetFrames = 0;
+        if (++Resolution->UnderBudgetFrames >= DYNAMIC_RESOLUTION_UP_FRAMES) {
+            Resolution->UnderBudgetFrames = 0;
+            Resolution->Scale += DYNAMIC_RESOLUTION_UP_STEP;
+        }
+    }
+    else {
+        Resolution->OverBudgetFrames = 0;
+        Resolution->UnderBudgetFrames = 0;
+    }
+
+    if (Resolution->Scale < DYNAMIC_RESOLUTION_MIN_SCALE) {
+        Resolution->Scale = DYNAMIC_RESOLUTION_MIN_SCALE;
+    }
+    if (Resolution->Scale > 1.f) {
+        Resolution->Scale = 1.f;
+    }
+}
+
+// The targets stay allocated at TARGET_WIDTH x TARGET_HEIGHT and the
+// scene renders into a sub-rect. The base size follows the window, so
+// small windows don't pay for full HD.
+static void UpdateRenderSize(opengl *OpenGL) {
+    u32 BaseWidth = GlobalScreenWidth < TARGET_WIDTH ? GlobalScreenWidth : TARGET_WIDTH;
+    u32 BaseHeight = GlobalScreenHeight < TARGET_HEIGHT ? GlobalScreenHeight : TARGET_HEIGHT;
+    f32 Scale = OpenGL->DynamicResolution.Scale;
+    OpenGL->RenderWidth = (u32)(Scale*BaseWidth);
+    OpenGL->RenderHeight = (u32)(Scale*BaseHeight);
+    if (OpenGL->RenderWidth < 1) {
+        OpenGL->RenderWidth = 1;
+    }
+    if (OpenGL->RenderHeight < 1) {
+        OpenGL->RenderHeight = 1;
+    }
 }
 
 static render_commands BeginFrame(opengl *OpenGL) {
     render_commands Commands = {};
 
-    Commands.UploadQueue = OpenGL->UploadQueueData;
-    Commands.MaxUploadQueueCount = ArrayCount(OpenGL->UploadQueueData);
+    Commands.UploadQueue = &OpenGL->UploadQueue;
 
     Commands.LineGroup.Vertices = OpenGL->LineVertexPushBufferData;
     Commands.LineGroup.MaxVertexCount = ArrayCount(OpenGL->LineVertexPushBufferData);
@@ -324,19 +1276,28 @@ static render_commands BeginFrame(opengl *OpenGL) {
     Commands.LineGroup.MaxIndexCount = ArrayCount(OpenGL->LineIndexPushBufferData);
 
     Commands.QuadGroup.Vertices = OpenGL->QuadVertexPushBufferData;
+    Commands.QuadGroup.ObjectIDs = OpenGL->QuadObjectIDPushBufferData;
     Commands.QuadGroup.MaxVertexCount = ArrayCount(OpenGL->QuadVertexPushBufferData);
-    Commands.QuadGroup.Indices = OpenGL->QuadIndexPushBufferData;
-    Commands.QuadGroup.MaxIndexCount = ArrayCount(OpenGL->QuadIndexPushBufferData);
 
-    Commands.Entries = OpenGL->RenderEntryData;
+    Commands.Entries = (u8 *)OpenGL->RenderEntryData;
     Commands.MaxRenderEntrySize = sizeof(OpenGL->RenderEntryData);
 
+    for (u32 i = 0; i < ArrayCount(OpenGL->SubCommandData); ++i) {
+        OpenGL->SubCommandData[i].Entries = OpenGL->SubRenderEntryData[i];
+        OpenGL->SubCommandData[i].MaxRenderEntrySize = sizeof(OpenGL->SubRenderEntryData[i]);
+    }
+    Commands.SubCommands = OpenGL->SubCommandData;
+    Commands.MaxSubCommandCount = ArrayCount(OpenGL->SubCommandData);
+
+    PollPickReadback(OpenGL);
+    Commands.PickedObjectID = OpenGL->PickReadback.ObjectID;
+
     return Commands;
 }
 
-static inline void BeginUseMesh(opengl *OpenGL, mesh_index Index) {
-    glBindVertexArray(OpenGL->Meshes[Index].VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, OpenGL->Meshes[Index].VBO);
+static inline void BeginUseMesh(opengl_mesh *Mesh) {
+    glBindVertexArray(Mesh->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, Mesh->VBO);
 }
 
 static inline void EndUseMesh() {
@@ -344,79 +1305,351 @@ static inline void EndUseMesh() {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-static u32 EndFrame(opengl *OpenGL, render_commands *Commands) {
+//
+// GPU timers
+//
+static void BeginGPUTimers(opengl *OpenGL) {
+    opengl_gpu_timers *Timers = &OpenGL->GPUTimers;
+    if (!Timers->Enabled) {
+        return;
+    }
+
+    // This frame's slot was last written GPU_TIMER_FRAME_COUNT frames ago.
+    // If the last timestamp isn't in yet, keep the old numbers rather than
+    // waiting on the GPU.
+    GLuint *Queries = Timers->Queries[Timers->FrameIndex];
+    if (Timers->FramesIssued >= GPU_TIMER_FRAME_COUNT) {
+        GLuint Available = 0;
+        glGetQueryObjectuiv(Queries[GPU_PASS_COUNT], GL_QUERY_RESULT_AVAILABLE, &Available);
+        if (Available) {
+            GLuint64 Timestamps[GPU_PASS_COUNT + 1];
+            for (u32 i = 0; i < ArrayCount(Timestamps); ++i) {
+                glGetQueryObjectui64v(Queries[i], GL_QUERY_RESULT, &Timestamps[i]);
+            }
+            for (u32 Pass = 0; Pass < GPU_PASS_COUNT; ++Pass) {
+                Timers->PassMs[Pass] = (f32)((f64)(Timestamps[Pass + 1] - Timestamps[Pass])/1000000.0);
+            }
+            Timers->FrameMs = (f32)((f64)(Timestamps[GPU_PASS_COUNT] - Timestamps[0])/1000000.0);
+        }
+    }
+    glQueryCounter(Queries[0], GL_TIMESTAMP);
+}
+
+// Marks the end of Pass and the start of the next one
+static inline void EndGPUPass(opengl *OpenGL, gpu_pass Pass) {
+    opengl_gpu_timers *Timers = &OpenGL->GPUTimers;
+    if (Timers->Enabled) {
+        glQueryCounter(Timers->Queries[Timers->FrameIndex][Pass + 1], GL_TIMESTAMP);
+    }
+}
+
+static void EndGPUTimers(opengl *OpenGL) {
+    opengl_gpu_timers *Timers = &OpenGL->GPUTimers;
+    if (Timers->Enabled) {
+        Timers->FrameIndex = (Timers->FrameIndex + 1) % GPU_TIMER_FRAME_COUNT;
+        ++Timers->FramesIssued;
+    }
+}
+
+static render_stats EndFrame(opengl *OpenGL, render_commands *Commands) {
+    // The game's first frame, and its asset loading, ran while these compiled
+    if (OpenGL->ProgramBatch.Count) {
+        FinishProgramBatch(OpenGL);
+    }
+    BeginGPUTimers(OpenGL);
 
-    for (u32 i = 0; i < Commands->UploadQueueCount; ++i) {
-        // TODO: add ability to delete meshes too
-        upload_work *Work = &Commands->UploadQueue[i];
-        OpenGLCreateMesh(OpenGL, Work->Index, Work->Mesh);
+    // Compared against the request, a count the driver can't do would
+    // otherwise rebuild the targets every frame
+    if (Commands->SampleCount && Commands->SampleCount != OpenGL->RequestedSampleCount) {
+        CreateSceneTarget(OpenGL, Commands->SampleCount);
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, OpenGL->MultisampledFBO);
-    glViewport(0, 0, TARGET_WIDTH, TARGET_HEIGHT);
-    glClearColor(.1f, .1f, .1f, 1.f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    opengl_static_geometry *StaticGeometry = &OpenGL->StaticGeometry;
+    if (Commands->MeshBudgetBytes && Commands->MeshBudgetBytes != StaticGeometry->BudgetBytes) {
+        size_t BudgetBytes = Commands->MeshBudgetBytes;
+        if (BudgetBytes > STATIC_GEOMETRY_CAPACITY_BYTES) {
+            LWARN("Mesh budget of %zu bytes is over the %zu byte capacity.", BudgetBytes, (size_t)STATIC_GEOMETRY_CAPACITY_BYTES);
+            BudgetBytes = STATIC_GEOMETRY_CAPACITY_BYTES;
+        }
+        if (BudgetBytes != StaticGeometry->BudgetBytes) {
+            StaticGeometry->BudgetBytes = BudgetBytes;
+            LINFO("Mesh budget: %zu bytes.", StaticGeometry->BudgetBytes);
+            // Nothing has been drawn yet this frame, so a lower budget can be
+            // met right away instead of waiting for the next upload
+            while (StaticGeometry->ResidentBytes > StaticGeometry->BudgetBytes && EvictLeastRecentlyUsedMesh(StaticGeometry)) {}
+        }
+    }
+
+    StreamMeshUploads(OpenGL);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, OpenGL->SceneTarget->FBO);
+    UpdateRenderSize(OpenGL);
+    glViewport(0, 0, OpenGL->RenderWidth, OpenGL->RenderHeight);
+    // glClear on the integer ID attachment is undefined, each color
+    // attachment is cleared with its own type
+    f32 ClearColor[] = {.1f, .1f, .1f, 1.f};
+    GLuint ClearObjectID[] = {OBJECT_ID_NONE, 0, 0, 0};
+    glClearBufferfv(GL_COLOR, 0, ClearColor);
+    glClearBufferuiv(GL_COLOR, 1, ClearObjectID);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    // The query issued two frames ago is read back, which is normally done
+    // by now. If it isn't, the last known count is kept rather than stalling.
+    GLuint FragmentQuery = 0;
+    if (OpenGL->HasPipelineStatistics) {
+        FragmentQuery = OpenGL->FragmentQueries[OpenGL->FragmentQueryIndex];
+        OpenGL->FragmentQueryIndex = (OpenGL->FragmentQueryIndex + 1) % ArrayCount(OpenGL->FragmentQueries);
+        GLuint Available = 0;
+        if (OpenGL->FragmentQueriesIssued >= ArrayCount(OpenGL->FragmentQueries)) {
+            glGetQueryObjectuiv(FragmentQuery, GL_QUERY_RESULT_AVAILABLE, &Available);
+        }
+        if (Available) {
+            GLuint64 Invocations = 0;
+            glGetQueryObjectui64v(FragmentQuery, GL_QUERY_RESULT, &Invocations);
+            OpenGL->FragmentInvocations = Invocations;
+        }
+        glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, FragmentQuery);
+        ++OpenGL->FragmentQueriesIssued;
+    }
 
-    BeginUseMesh(OpenGL, MESH_INDEX_LINE_PUSH_BUFFER);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, Commands->LineGroup.VertexCount*sizeof(vertex), Commands->LineGroup.Vertices);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, Commands->LineGroup.IndexCount*sizeof(vertex), Commands->LineGroup.Indices);
+    BeginUseMesh(&OpenGL->LinePushBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, Commands->LineGroup.VertexCount*sizeof(line_vertex), Commands->LineGroup.Vertices);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, Commands->LineGroup.IndexCount*sizeof(u16), Commands->LineGroup.Indices);
 
-    BeginUseMesh(OpenGL, MESH_INDEX_QUAD_PUSH_BUFFER);
+    BeginUseMesh(&OpenGL->QuadPushBuffer);
     glBufferSubData(GL_ARRAY_BUFFER, 0, Commands->QuadGroup.VertexCount*sizeof(vertex), Commands->QuadGroup.Vertices);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, Commands->QuadGroup.IndexCount*sizeof(vertex), Commands->QuadGroup.Indices);
+    glBindBuffer(GL_ARRAY_BUFFER, OpenGL->QuadObjectIDBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, Commands->QuadGroup.VertexCount*sizeof(u32), Commands->QuadGroup.ObjectIDs);
+    EndGPUPass(OpenGL, GPU_PASS_UPLOAD);
 
     //
     // Multisample pass
     //
-    u32  LineGroupBaseOffset = 0;
-    u32  QuadGroupBaseOffset = 0;
+    u32 LineCommandCount = 0;
+    u32 QuadCommandCount = 0;
+    u32 MeshCommandCount = 0;
     u32 DrawCallCounter = 0;
+    u32 MeshTriangleCounter = 0;
+    b32 CompositeOIT = false;
     for (size_t BufferOffset = 0; BufferOffset < Commands->RenderEntrySize;) {
-        render_entry_header *Typeless = Commands->Entries + BufferOffset;
+        render_entry_header *Typeless = (render_entry_header *)(Commands->Entries + BufferOffset);
         switch (Typeless->Type) {
             case TYPE_render_entry_mesh: {
-                render_entry_mesh *Entry = (render_entry_mesh *)Typeless;
-                BufferOffset += sizeof(*Entry);
-
+                // Consumes the whole run of consecutive meshes. They share
+                // the static VAO, so the run is one multi-draw when indirect
+                // draws are available and needs no rebinding either way.
+                // BaseInstance picks each mesh's object ID.
                 glUseProgram(OpenGL->UnlitProgram.Common.Handle);
                 f32 Aspect = (f32)GlobalScreenWidth/GlobalScreenHeight;
                 mat4 Transform = CalculateWorldTransform(Commands->Camera, Aspect);
                 glUniformMatrix4fv(OpenGL->UnlitProgram.Transform, 1, GL_TRUE, Transform.Elements);
-
-                BeginUseMesh(OpenGL, Entry->Index);
-
-                u32 IndexCount = Commands->Assets->Meshes[Entry->Index].IndexCount;
-                glDrawElements(GL_TRIANGLES, IndexCount, GL_UNSIGNED_SHORT, 0);
-                ++DrawCallCounter;
+                glBindVertexArray(StaticGeometry->VAO);
+
+                u32 RunStart = MeshCommandCount;
+                while (BufferOffset < Commands->RenderEntrySize) {
+                    render_entry_header *Header = (render_entry_header *)(Commands->Entries + BufferOffset);
+                    if (Header->Type != TYPE_render_entry_mesh) {
+                        break;
+                    }
+                    render_entry_mesh *Entry = (render_entry_mesh *)Header;
+                    BufferOffset += sizeof(*Entry);
+
+                    opengl_static_mesh *StaticMesh = StaticGeometry->Meshes + Entry->Slot;
+                    if (!StaticMesh->Resident) {
+                        // Evicted earlier, it streams back in from the CPU
+                        // copy and is skipped until then. Meshes still
+                        // streaming in wait for it to finish.
+                        if (!StaticMesh->Streaming && StaticMesh->Source) {
+                            QueueMeshReupload(OpenGL, Entry->Slot);
+                        }
+                        continue;
+                    }
+                    StaticMesh->LastUsedFrame = StaticGeometry->FrameIndex;
+
+                    // Every LOD is resident with the mesh, only the parts drawn
+                    // change. Each part is its own draw with its own BaseVertex,
+                    // which keeps the indices 16 bit.
+                    mesh_object *Source = StaticMesh->Source;
+                    mesh_lod *LOD = GetMeshLOD(Source, Entry->LOD);
+                    for (u32 PartIndex = LOD->FirstPart; PartIndex < LOD->FirstPart + LOD->PartCount; ++PartIndex) {
+                        mesh_part *Part = Source->Parts + PartIndex;
+                        u32 FirstIndex = StaticMesh->FirstIndex + Part->FirstIndex;
+                        u32 BaseVertex = StaticMesh->BaseVertex + Part->BaseVertex;
+                        MeshTriangleCounter += Part->IndexCount/3;
+                        if (OpenGL->UseIndirectDraws) {
+                            Assert(MeshCommandCount < ArrayCount(OpenGL->MeshIndirectCommands));
+                            opengl_draw_elements_indirect_command *Command = OpenGL->MeshIndirectCommands + MeshCommandCount++;
+                            Command->Count = Part->IndexCount;
+                            Command->InstanceCount = 1;
+                            Command->FirstIndex = FirstIndex;
+                            Command->BaseVertex = BaseVertex;
+                            Command->BaseInstance = Entry->Slot + 1;
+                        }
+                        else if (glDrawElementsInstancedBaseVertexBaseInstance) {
+                            glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, Part->IndexCount, GL_UNSIGNED_SHORT,
+                                    (GLvoid *)(FirstIndex*sizeof(u16)), 1, BaseVertex, Entry->Slot + 1);
+                            ++DrawCallCounter;
+                        }
+                        else {
+                            // Reads instance zero, the mesh can't be picked
+                            glDrawElementsBaseVertex(GL_TRIANGLES, Part->IndexCount, GL_UNSIGNED_SHORT,
+                                    (GLvoid *)(FirstIndex*sizeof(u16)), BaseVertex);
+                            ++DrawCallCounter;
+                        }
+                    }
+                }
+
+                if (MeshCommandCount > RunStart) {
+                    // Mesh commands sit after the line and quad commands, and
+                    // each run gets its own range so nothing is overwritten
+                    // while an earlier multi-draw may still read it
+                    size_t RunOffset = sizeof(OpenGL->LineIndirectCommands) + sizeof(OpenGL->QuadIndirectCommands) +
+                        RunStart*sizeof(opengl_draw_elements_indirect_command);
+                    u32 RunCount = MeshCommandCount - RunStart;
+                    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, OpenGL->IndirectBuffer);
+                    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, RunOffset, RunCount*sizeof(opengl_draw_elements_indirect_command),
+                            OpenGL->MeshIndirectCommands + RunStart);
+                    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void *)RunOffset, RunCount, 0);
+                    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+                    ++DrawCallCounter;
+                }
             } break;
 
             case TYPE_render_entry_line_group: {
                 render_entry_line_group *Entry = (render_entry_line_group *)Typeless;
                 BufferOffset += sizeof(*Entry);
 
-                BeginUseMesh(OpenGL, MESH_INDEX_LINE_PUSH_BUFFER);
+                if (OpenGL->UseIndirectDraws) {
+                    Assert(LineCommandCount < ArrayCount(OpenGL->LineIndirectCommands));
+                    opengl_draw_elements_indirect_command *Command = OpenGL->LineIndirectCommands + LineCommandCount++;
+                    Command->Count = Entry->IndexCount;
+                    Command->InstanceCount = 1;
+                    Command->FirstIndex = Entry->FirstIndex;
+                    Command->BaseVertex = Entry->BaseVertex;
+                    Command->BaseInstance = 0;
+                    break;
+                }
+
+                BeginUseMesh(&OpenGL->LinePushBuffer);
                 glUseProgram(OpenGL->DebugProgram.Common.Handle);
                 f32 Aspect = (f32)GlobalScreenWidth/GlobalScreenHeight;
                 mat4 Transform = CalculateWorldTransform(Commands->Camera, Aspect);
                 glUniformMatrix4fv(OpenGL->DebugProgram.Transform, 1, GL_TRUE, Transform.Elements);
-                glDrawElementsBaseVertex(GL_LINES, Entry->IndexCount, GL_UNSIGNED_SHORT, (GLvoid *)Entry->IndexOffset, LineGroupBaseOffset);
+                // Lines don't write object IDs, picks go through them
+                glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                glDrawElementsBaseVertex(GL_LINES, Entry->IndexCount, GL_UNSIGNED_SHORT, (GLvoid *)(Entry->FirstIndex*sizeof(u16)), Entry->BaseVertex);
+                glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
                 ++DrawCallCounter;
-                LineGroupBaseOffset += Entry->VertexCount;
             } break;
 
             case TYPE_render_entry_quad_group: {
                 render_entry_quad_group *Entry = (render_entry_quad_group *)Typeless;
                 BufferOffset += sizeof(*Entry);
 
-                BeginUseMesh(OpenGL, MESH_INDEX_QUAD_PUSH_BUFFER);
+                u32 IndexCount = 6*(Entry->VertexCount/4);
+                if (OpenGL->UseIndirectDraws) {
+                    Assert(QuadCommandCount < ArrayCount(OpenGL->QuadIndirectCommands));
+                    opengl_draw_elements_indirect_command *Command = OpenGL->QuadIndirectCommands + QuadCommandCount++;
+                    Command->Count = IndexCount;
+                    Command->InstanceCount = 1;
+                    Command->FirstIndex = 0;
+                    Command->BaseVertex = Entry->BaseVertex;
+                    Command->BaseInstance = 0;
+                    break;
+                }
+
+                BeginUseMesh(&OpenGL->QuadPushBuffer);
                 glUseProgram(OpenGL->CircleProgram.Common.Handle);
                 f32 Aspect = (f32)GlobalScreenWidth/GlobalScreenHeight;
                 mat4 Transform = CalculateWorldTransform(Commands->Camera, Aspect);
                 glUniformMatrix4fv(OpenGL->CircleProgram.Transform, 1, GL_TRUE, Transform.Elements);
                 glUniform1f(OpenGL->CircleProgram.Radius, 1.f);
-                glDrawElementsBaseVertex(GL_TRIANGLES, Entry->IndexCount, GL_UNSIGNED_SHORT, (GLvoid *)Entry->IndexOffset, QuadGroupBaseOffset);
+                glDrawElementsBaseVertex(GL_TRIANGLES, IndexCount, GL_UNSIGNED_INT, 0, Entry->BaseVertex);
+                ++DrawCallCounter;
+            } break;
+
+            case TYPE_render_entry_circle_records: {
+                render_entry_circle_records *Entry = (render_entry_circle_records *)Typeless;
+                BufferOffset += sizeof(*Entry);
+
+                glBindVertexArray(OpenGL->CircleRecordVAO);
+                glBindBuffer(GL_ARRAY_BUFFER, OpenGL->CircleRecordBuffer);
+
+                // Only dirty records are uploaded, runs of consecutive
+                // indices go up in a single call.
+                for (u32 i = 0; i < Entry->DirtyCount;) {
+                    u32 First = Entry->DirtyIndices[i];
+                    u32 Count = 1;
+                    while (i + Count < Entry->DirtyCount && Entry->DirtyIndices[i + Count] == First + Count) {
+                        ++Count;
+                    }
+                    glBufferSubData(GL_ARRAY_BUFFER, First*sizeof(circle_record), Count*sizeof(circle_record), Entry->Records + First);
+                    i += Count;
+                }
+
+                if (Entry->RecordCount) {
+                    glUseProgram(OpenGL->RetainedCircleProgram.Common.Handle);
+                    f32 Aspect = (f32)GlobalScreenWidth/GlobalScreenHeight;
+                    mat4 Transform = CalculateWorldTransform(Commands->Camera, Aspect);
+                    glUniformMatrix4fv(OpenGL->RetainedCircleProgram.Transform, 1, GL_TRUE, Transform.Elements);
+                    glUniform1f(OpenGL->RetainedCircleProgram.Radius, 1.f);
+                    glUniform1f(OpenGL->RetainedCircleProgram.Time, Entry->Time);
+                    glUniform1f(OpenGL->RetainedCircleProgram.Speed, Entry->Speed);
+                    glUniform1i(OpenGL->RetainedCircleProgram.HotIndex, Entry->HotIndex);
+                    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, Entry->RecordCount);
+                    ++DrawCallCounter;
+                }
+            } break;
+
+            case TYPE_render_entry_circle_instances: {
+                render_entry_circle_instances *Entry = (render_entry_circle_instances *)Typeless;
+                BufferOffset += sizeof(*Entry);
+
+                if (!Entry->InstanceCount) {
+                    break;
+                }
+
+                glBindVertexArray(OpenGL->CircleInstanceVAO);
+                glBindBuffer(GL_ARRAY_BUFFER, OpenGL->CircleInstanceBuffer);
+                glBufferData(GL_ARRAY_BUFFER, MAX_CIRCLE_COUNT*sizeof(circle_instance), 0, GL_STREAM_DRAW);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, Entry->InstanceCount*sizeof(circle_instance), Entry->Instances);
+
+                f32 Aspect = (f32)GlobalScreenWidth/GlobalScreenHeight;
+                mat4 Transform = CalculateWorldTransform(Commands->Camera, Aspect);
+                if (Entry->Mode == CIRCLE_RENDER_MODE_OIT) {
+                    if (!OpenGL->OITTarget.FBO) {
+                        CreateOITTarget(OpenGL);
+                    }
+                    glBindFramebuffer(GL_FRAMEBUFFER, OpenGL->OITTarget.FBO);
+                    if (!CompositeOIT) {
+                        f32 ClearAccumulation[] = {0.f, 0.f, 0.f, 0.f};
+                        f32 ClearRevealage[] = {1.f, 1.f, 1.f, 1.f};
+                        glClearBufferfv(GL_COLOR, 0, ClearAccumulation);
+                        glClearBufferfv(GL_COLOR, 1, ClearRevealage);
+                        CompositeOIT = true;
+                    }
+
+                    // Accumulation sums weighted premultiplied color,
+                    // revealage multiplies up (1 - alpha)
+                    glDepthMask(GL_FALSE);
+                    glBlendFunci(0, GL_ONE, GL_ONE);
+                    glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+                    glUseProgram(OpenGL->OITCircleProgram.Common.Handle);
+                    glUniformMatrix4fv(OpenGL->OITCircleProgram.Transform, 1, GL_TRUE, Transform.Elements);
+                    glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 8, Entry->InstanceCount);
+                    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                    glDepthMask(GL_TRUE);
+                    glBindFramebuffer(GL_FRAMEBUFFER, OpenGL->SceneTarget->FBO);
+                }
+                else {
+                    Assert(Entry->Mode == CIRCLE_RENDER_MODE_OPAQUE);
+                    glUseProgram(OpenGL->OpaqueCircleProgram.Common.Handle);
+                    glUniformMatrix4fv(OpenGL->OpaqueCircleProgram.Transform, 1, GL_TRUE, Transform.Elements);
+                    glDisable(GL_BLEND);
+                    glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 8, Entry->InstanceCount);
+                    glEnable(GL_BLEND);
+                }
                 ++DrawCallCounter;
-                QuadGroupBaseOffset += Entry->VertexCount;
             } break;
 
             default:
@@ -424,33 +1657,153 @@ static u32 EndFrame(opengl *OpenGL, render_commands *Commands) {
         }
     }
 
-    glUseProgram(0);
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
     //
-    // Resolve frame
+    // Indirect submission, one multi-draw per group type
     //
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, OpenGL->MultisampledFBO);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, OpenGL->ResolveFBO);
-    glBlitFramebuffer(0, 0, TARGET_WIDTH, TARGET_HEIGHT,
-            0, 0, TARGET_WIDTH, TARGET_HEIGHT,
-            GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    if (LineCommandCount || QuadCommandCount) {
+        f32 Aspect = (f32)GlobalScreenWidth/GlobalScreenHeight;
+        mat4 Transform = CalculateWorldTransform(Commands->Camera, Aspect);
+
+        size_t LineCommandsSize = LineCommandCount*sizeof(opengl_draw_elements_indirect_command);
+        size_t QuadCommandsSize = QuadCommandCount*sizeof(opengl_draw_elements_indirect_command);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, OpenGL->IndirectBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, LineCommandsSize, OpenGL->LineIndirectCommands);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, LineCommandsSize, QuadCommandsSize, OpenGL->QuadIndirectCommands);
+
+        if (LineCommandCount) {
+            BeginUseMesh(&OpenGL->LinePushBuffer);
+            glUseProgram(OpenGL->DebugProgram.Common.Handle);
+            glUniformMatrix4fv(OpenGL->DebugProgram.Transform, 1, GL_TRUE, Transform.Elements);
+            glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            glMultiDrawElementsIndirect(GL_LINES, GL_UNSIGNED_SHORT, (void *)0, LineCommandCount, 0);
+            glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            ++DrawCallCounter;
+        }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (QuadCommandCount) {
+            BeginUseMesh(&OpenGL->QuadPushBuffer);
+            glUseProgram(OpenGL->CircleProgram.Common.Handle);
+            glUniformMatrix4fv(OpenGL->CircleProgram.Transform, 1, GL_TRUE, Transform.Elements);
+            glUniform1f(OpenGL->CircleProgram.Radius, 1.f);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)LineCommandsSize, QuadCommandCount, 0);
+            ++DrawCallCounter;
+        }
 
-    glUseProgram(OpenGL->ResolveProgram.Common.Handle);
-    glBindVertexArray(OpenGL->ResolveVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, OpenGL->ResolveVBO);
-    glViewport(0, 0, GlobalScreenWidth, GlobalScreenHeight);
-    glClearColor(1.0f, 0.0f, 1.0f, 1.f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glBindTexture(GL_TEXTURE_2D, OpenGL->ResolveTexture);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    //
+    // OIT composite, blends the averaged circle color over the scene
+    //
+    if (CompositeOIT) {
+        opengl_oit_target *OIT = &OpenGL->OITTarget;
+        b32 Multisampled = (OIT->Samples > 1);
+        GLenum TextureTarget = Multisampled ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+        opengl_oit_composite_program *Program = Multisampled ? &OpenGL->OITCompositeMSProgram : &OpenGL->OITCompositeProgram;
+
+        glDisable(GL_DEPTH_TEST);
+        glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glUseProgram(Program->Common.Handle);
+        glBindVertexArray(OpenGL->ResolveVAO);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(TextureTarget, OIT->Accumulation);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(TextureTarget, OIT->Revealage);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glBindTexture(TextureTarget, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+        ++DrawCallCounter;
+
+        GLenum Attachments[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glBindFramebuffer(GL_FRAMEBUFFER, OIT->FBO);
+        glInvalidateFramebuffer(GL_FRAMEBUFFER, ArrayCount(Attachments), Attachments);
+        glBindFramebuffer(GL_FRAMEBUFFER, OpenGL->SceneTarget->FBO);
+    }
 
     glUseProgram(0);
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    return DrawCallCounter;
+    if (FragmentQuery) {
+        glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+    }
+    IssuePickReadback(OpenGL);
+    EndGPUPass(OpenGL, GPU_PASS_SCENE);
+
+    //
+    // Resolve frame
+    //
+    // The default framebuffer can take the resolve directly when no scaling
+    // is needed, or when the scene isn't multisampled and the blit can
+    // filter. Otherwise resolve into a transient target and scale with the
+    // present shader.
+    //
+    opengl_render_target *Scene = OpenGL->SceneTarget;
+    b32 DirectResolve = (Scene->Samples == 1 ||
+            (OpenGL->RenderWidth == (u32)GlobalScreenWidth && OpenGL->RenderHeight == (u32)GlobalScreenHeight));
+    if (DirectResolve) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, Scene->FBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, OpenGL->RenderWidth, OpenGL->RenderHeight,
+                0, 0, GlobalScreenWidth, GlobalScreenHeight,
+                GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        InvalidateRenderTarget(Scene, true, true);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        EndGPUPass(OpenGL, GPU_PASS_RESOLVE);
+    }
+    else {
+        opengl_render_target *Resolve = AcquireRenderTarget(OpenGL, TARGET_WIDTH, TARGET_HEIGHT, 1, false, false);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, Scene->FBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, Resolve->FBO);
+        glBlitFramebuffer(0, 0, OpenGL->RenderWidth, OpenGL->RenderHeight,
+                0, 0, OpenGL->RenderWidth, OpenGL->RenderHeight,
+                GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        InvalidateRenderTarget(Scene, true, true);
+        EndGPUPass(OpenGL, GPU_PASS_RESOLVE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glUseProgram(OpenGL->ResolveProgram.Common.Handle);
+        glBindVertexArray(OpenGL->ResolveVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, OpenGL->ResolveVBO);
+        glViewport(0, 0, GlobalScreenWidth, GlobalScreenHeight);
+        glDisable(GL_DEPTH_TEST);
+        glBindTexture(GL_TEXTURE_2D, Resolve->Color);
+        vec2 UVScale = vec2((f32)OpenGL->RenderWidth/TARGET_WIDTH, (f32)OpenGL->RenderHeight/TARGET_HEIGHT);
+        glUniform2fv(OpenGL->ResolveProgram.UVScale, 1, UVScale.Elements);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glEnable(GL_DEPTH_TEST);
+
+        glUseProgram(0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        InvalidateRenderTarget(Resolve, true, false);
+        ReleaseRenderTarget(Resolve);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // A direct resolve has no present pass, it measures as zero
+    EndGPUPass(OpenGL, GPU_PASS_PRESENT);
+    EndGPUTimers(OpenGL);
+
+    render_stats Stats = {};
+    Stats.DrawCalls = DrawCallCounter;
+    Stats.MeshTriangles = MeshTriangleCounter;
+    Stats.DirectResolve = DirectResolve;
+    Stats.FragmentInvocations = OpenGL->FragmentInvocations;
+    for (u32 Pass = 0; Pass < GPU_PASS_COUNT; ++Pass) {
+        Stats.GPUPassMs[Pass] = OpenGL->GPUTimers.PassMs[Pass];
+    }
+    Stats.GPUFrameMs = OpenGL->GPUTimers.FrameMs;
+    Stats.RenderScale = OpenGL->DynamicResolution.Scale;
+    Stats.RenderWidth = OpenGL->RenderWidth;
+    Stats.RenderHeight = OpenGL->RenderHeight;
+    Stats.MeshResidentBytes = StaticGeometry->ResidentBytes;
+    Stats.MeshBudgetBytes = StaticGeometry->BudgetBytes;
+    Stats.MeshEvictions = StaticGeometry->EvictionCount;
+    ++StaticGeometry->FrameIndex;
+    return Stats;
 }
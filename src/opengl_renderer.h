@@ -11,6 +11,7 @@ struct opengl_simple_unlit_program {
 
 struct opengl_resolve_frame_program {
     opengl_shader_common Common;
+    GLuint UVScale;
 };
 
 struct opengl_debug_program {
@@ -24,39 +25,345 @@ struct opengl_unlit_circle_program {
     GLuint Radius;
 };
 
+// Scales the scene's render size to hold FrameTime near the budget.
+// Separate thresholds and frame counts for going down and up give
+// hysteresis, so the scale doesn't oscillate around the budget.
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5f
+#define DYNAMIC_RESOLUTION_DOWN_STEP 0.1f
+#define DYNAMIC_RESOLUTION_UP_STEP 0.05f
+#define DYNAMIC_RESOLUTION_DOWN_FRAMES 8
+#define DYNAMIC_RESOLUTION_UP_FRAMES 60
+struct dynamic_resolution {
+    b32 Enabled;
+    f32 Scale;
+    f32 BudgetMs;
+    f32 FilteredFrameMs;
+    u32 OverBudgetFrames;
+    u32 UnderBudgetFrames;
+};
+
+// Targets are pooled by description. A released target stays allocated
+// and is handed back to the next acquire with the same size, sample count
+// and depth, so passes that don't overlap share the same storage.
+// Targets with object IDs have an R32UI second color attachment.
+#define MAX_RENDER_TARGET_COUNT 8
+struct opengl_render_target {
+    GLuint FBO;
+    GLuint Color;
+    GLuint ObjectIDs;
+    GLuint Depth;
+    u32 Width;
+    u32 Height;
+    u32 Samples;
+    b32 HasDepth;
+    b32 HasObjectIDs;
+    b32 InUse;
+};
+
+// GPU timestamps are written between passes, so each pass is measured as
+// the time between its neighbours. A frame's set of queries is read back
+// GPU_TIMER_FRAME_COUNT frames later, when it's normally long done.
+enum gpu_pass {
+    GPU_PASS_UPLOAD,
+    GPU_PASS_SCENE,
+    GPU_PASS_RESOLVE,
+    GPU_PASS_PRESENT,
+
+    GPU_PASS_COUNT
+};
+
+#define GPU_TIMER_FRAME_COUNT 2
+struct opengl_gpu_timers {
+    b32 Enabled;
+    GLuint Queries[GPU_TIMER_FRAME_COUNT][GPU_PASS_COUNT + 1];
+    u32 FrameIndex;
+    u32 FramesIssued;
+
+    f32 PassMs[GPU_PASS_COUNT];
+    f32 FrameMs;
+};
+
+// The scene's object ID under the mouse is blitted into a 1x1 target
+// and copied into a pixel pack buffer, with a fence behind it. Slots are
+// read back once their fence has signaled, normally a frame later, and
+// nothing ever waits on one. A slot still in flight skips the copy.
+#define PICK_READBACK_SLOT_COUNT 3
+struct opengl_pick_readback {
+    b32 Enabled;
+    GLuint FBO;
+    GLuint Texture;
+    GLuint Buffers[PICK_READBACK_SLOT_COUNT];
+    GLsync Fences[PICK_READBACK_SLOT_COUNT];
+    u32 SlotIndex;
+
+    u32 ObjectID;
+};
+
+struct render_stats {
+    u32 DrawCalls;
+    b32 DirectResolve;
+
+    f32 RenderScale;
+    u32 RenderWidth;
+    u32 RenderHeight;
+
+    // Fragment shader invocations for the scene pass, from the frame
+    // before last. Zero when pipeline statistics aren't supported.
+    u64 FragmentInvocations;
+
+    // GPU milliseconds per pass and for the whole frame, from
+    // GPU_TIMER_FRAME_COUNT frames ago
+    f32 GPUPassMs[GPU_PASS_COUNT];
+    f32 GPUFrameMs;
+
+    size_t MeshResidentBytes;
+    size_t MeshBudgetBytes;
+    u32 MeshEvictions;
+    // Static mesh triangles drawn at the selected LODs
+    u32 MeshTriangles;
+};
+
+// Layout is fixed by GL for glMultiDrawElementsIndirect
+struct opengl_draw_elements_indirect_command {
+    GLuint Count;
+    GLuint InstanceCount;
+    GLuint FirstIndex;
+    GLint BaseVertex;
+    GLuint BaseInstance;
+};
+
+struct opengl_retained_circle_program {
+    opengl_shader_common Common;
+    GLuint Transform;
+    GLuint Radius;
+    GLuint Time;
+    GLuint Speed;
+    GLuint HotIndex;
+};
+
+struct opengl_opaque_circle_program {
+    opengl_shader_common Common;
+    GLuint Transform;
+};
+
+struct opengl_oit_circle_program {
+    opengl_shader_common Common;
+    GLuint Transform;
+};
+
+struct opengl_oit_composite_program {
+    opengl_shader_common Common;
+    GLuint Accumulation;
+    GLuint Revealage;
+};
+
+// Accumulation and revealage for weighted blended OIT. Created on first
+// use with the scene's size and sample count, and attached to the scene's
+// depth buffer so circles are still hidden by opaque geometry.
+struct opengl_oit_target {
+    GLuint FBO;
+    GLuint Accumulation;
+    GLuint Revealage;
+    u32 Samples;
+};
+
+struct opengl;
+typedef void opengl_program_setup(opengl *OpenGL, opengl_shader_common *Common);
+
+// A program whose compile and link have been queued but not checked.
+// Programs loaded from the cache have no shaders to check.
+struct opengl_pending_program {
+    opengl_shader_common *Common;
+    opengl_program_setup *Setup;
+    GLuint VertexShader;
+    GLuint FragmentShader;
+    u64 Key;
+};
+
+#define MAX_PENDING_PROGRAM_COUNT 16
+struct opengl_program_batch {
+    opengl_pending_program Programs[MAX_PENDING_PROGRAM_COUNT];
+    u32 Count;
+    u32 CachedCount;
+};
+
+struct opengl_startup_timings {
+    f64 InitSeconds;
+    f64 ShaderSubmitSeconds;
+    f64 ShaderWaitSeconds;
+};
+
+#define PROGRAM_CACHE_MAGIC 0x43475250 // "PRGC"
+#define PROGRAM_CACHE_VERSION 1
+struct program_cache_header {
+    u32 Magic;
+    u32 Version;
+    u64 Key;
+    u32 Format;
+    u32 Size;
+};
+
+// Push buffers keep their own VAO and buffers, everything static is
+// suballocated from opengl_static_geometry
 struct opengl_mesh {
     GLuint VAO;
     GLuint VBO;
     GLuint IBO;
 };
 
+// First-fit free list over a buffer, in elements. Free blocks are kept
+// sorted by offset so a freed range merges with its neighbours.
+#define MAX_BUFFER_FREE_BLOCK_COUNT 256
+#define BUFFER_ALLOCATION_FAILED 0xFFFFFFFF
+struct opengl_buffer_block {
+    u32 Offset;
+    u32 Count;
+};
+
+struct opengl_buffer_allocator {
+    u32 Capacity;
+    u32 UsedCount;
+    u32 FreeBlockCount;
+    opengl_buffer_block FreeBlocks[MAX_BUFFER_FREE_BLOCK_COUNT];
+};
+
+// A static mesh's ranges in the shared buffers, drawn with BaseVertex
+// so its u16 indices stay relative to its own vertices, and to each
+// part's vertices within those. Source is the
+// CPU copy in the assets arenas, kept so an evicted mesh can come back.
+struct opengl_static_mesh {
+    mesh_object *Source;
+    b32 Resident;
+    // Has its ranges but is still being copied in, not drawn until done
+    b32 Streaming;
+    // Evicted and drawn again, waiting in the mesh stream's re-upload ring
+    b32 ReuploadQueued;
+    u32 BaseVertex;
+    u32 VertexCount;
+    u32 FirstIndex;
+    u32 IndexCount;
+    u64 LastUsedFrame;
+};
+
+// Resident meshes are held under BudgetBytes by evicting the least
+// recently drawn ones. A mesh drawn this frame is never evicted, and an
+// evicted mesh is streamed back in once it's drawn again.
+#define STATIC_VERTEX_CAPACITY (1<<18)
+#define STATIC_INDEX_CAPACITY (1<<20)
+#define STATIC_GEOMETRY_CAPACITY_BYTES (STATIC_VERTEX_CAPACITY*sizeof(vertex) + STATIC_INDEX_CAPACITY*sizeof(u16))
+struct opengl_static_geometry {
+    GLuint VAO;
+    GLuint VBO;
+    GLuint IBO;
+    // Per instance object IDs, a mesh draws with BaseInstance one past
+    // its registry slot. Entry zero is OBJECT_ID_NONE for draws without
+    // one.
+    GLuint ObjectIDBuffer;
+    opengl_buffer_allocator VertexAllocator;
+    opengl_buffer_allocator IndexAllocator;
+    opengl_static_mesh Meshes[MAX_MESH_COUNT];
+
+    size_t BudgetBytes;
+    size_t ResidentBytes;
+    u64 FrameIndex;
+    u32 EvictionCount;
+};
+
 #define TARGET_WIDTH 1920
 #define TARGET_HEIGHT 1080
-#define MAX_UPLOAD_QUEUE_COUNT (1<<8)
-#define MAX_RENDER_ENTRY_COUNT (1<<10)
+#define MAX_RENDER_ENTRY_COUNT (1<<12)
+#define MAX_SUB_COMMAND_COUNT MAX_CIRCLE_JOB_COUNT
+#define MAX_SUB_RENDER_ENTRY_SIZE (1<<12)
 #define MAX_VERTEX_COUNT (1<<20)
 #define MAX_INDEX_COUNT (1<<24)
+#define MAX_QUAD_COUNT (MAX_VERTEX_COUNT/4)
+#define MAX_INDIRECT_COMMAND_COUNT MAX_RENDER_ENTRY_COUNT
+// Upload work is taken off the queue in order until a frame has copied
+// this many bytes. A mesh bigger than what's left keeps copying over
+// the next frames. Evicted meshes that are drawn again share the
+// budget, and go ahead of the queue.
+#define MESH_UPLOAD_BYTES_PER_FRAME (2*MiB)
+struct opengl_mesh_stream {
+    b32 Active;
+    upload_work Work;
+    u32 VerticesCopied;
+    u32 IndicesCopied;
+
+    // Only the render thread touches it, the positions wrap
+    u32 ReuploadSlots[MAX_MESH_COUNT];
+    u32 ReuploadReadPosition;
+    u32 ReuploadWritePosition;
+};
+
 struct opengl {
-    upload_work UploadQueueData[MAX_UPLOAD_QUEUE_COUNT];
+    upload_queue UploadQueue;
+    opengl_mesh_stream MeshStream;
     render_entry_header RenderEntryData[MAX_RENDER_ENTRY_COUNT];
+    render_commands SubCommandData[MAX_SUB_COMMAND_COUNT];
+    u8 SubRenderEntryData[MAX_SUB_COMMAND_COUNT][MAX_SUB_RENDER_ENTRY_SIZE];
     line_vertex LineVertexPushBufferData[MAX_VERTEX_COUNT];
     u16 LineIndexPushBufferData[MAX_INDEX_COUNT];
     vertex QuadVertexPushBufferData[MAX_VERTEX_COUNT];
-    u16 QuadIndexPushBufferData[MAX_INDEX_COUNT];
+    u32 QuadObjectIDPushBufferData[MAX_VERTEX_COUNT];
+    GLuint QuadObjectIDBuffer;
 
-    opengl_mesh Meshes[MESH_INDEX_MAX_COUNT];
+    opengl_mesh LinePushBuffer;
+    opengl_mesh QuadPushBuffer;
+    opengl_static_geometry StaticGeometry;
 
-    GLuint MultisampledTexture;
-    GLuint MultisampledFBO;
-    GLuint DepthRBO;
+    // When set, line and quad groups are collected into the indirect
+    // buffer and submitted with one glMultiDrawElementsIndirect per type
+    b32 UseIndirectDraws;
+    GLuint IndirectBuffer;
+    opengl_draw_elements_indirect_command LineIndirectCommands[MAX_INDIRECT_COMMAND_COUNT];
+    opengl_draw_elements_indirect_command QuadIndirectCommands[MAX_INDIRECT_COMMAND_COUNT];
+    opengl_draw_elements_indirect_command MeshIndirectCommands[MAX_INDIRECT_COMMAND_COUNT];
+
+    dynamic_resolution DynamicResolution;
+    u32 RenderWidth;
+    u32 RenderHeight;
+
+    opengl_render_target RenderTargets[MAX_RENDER_TARGET_COUNT];
+    opengl_render_target *SceneTarget;
+    opengl_oit_target OITTarget;
+    // What the scene target was last asked for, and what it got after
+    // clamping to the driver's limit
+    u32 RequestedSampleCount;
+    u32 SampleCount;
+
+    GLuint CircleRecordVAO;
+    GLuint CircleRecordBuffer;
+
+    GLuint CircleInstanceVAO;
+    GLuint CircleInstanceBuffer;
+
+    // Queries alternate per frame so reading one never waits on the GPU
+    b32 HasPipelineStatistics;
+    GLuint FragmentQueries[2];
+    u32 FragmentQueryIndex;
+    u32 FragmentQueriesIssued;
+    u64 FragmentInvocations;
+
+    opengl_gpu_timers GPUTimers;
+    opengl_pick_readback PickReadback;
 
-    GLuint ResolveTexture;
-    GLuint ResolveFBO;
     GLuint ResolveVAO;
     GLuint ResolveVBO;
 
+    b32 UseProgramCache;
+    u64 DriverHash;
+
+    b32 HasParallelShaderCompile;
+    opengl_program_batch ProgramBatch;
+    opengl_startup_timings StartupTimings;
+
     opengl_debug_program DebugProgram;
     opengl_simple_unlit_program UnlitProgram;
     opengl_unlit_circle_program CircleProgram;
+    opengl_retained_circle_program RetainedCircleProgram;
+    opengl_opaque_circle_program OpaqueCircleProgram;
+    opengl_oit_circle_program OITCircleProgram;
+    opengl_oit_composite_program OITCompositeProgram;
+    opengl_oit_composite_program OITCompositeMSProgram;
     opengl_resolve_frame_program ResolveProgram;
 };
@@ -5,12 +5,37 @@ static void *PlatformAllocate(size_t Size);
 static void PlatformDebugPrint(const char *Message, ...);
 static void PlatformMessageBox(const char *Message, ...);
 
+struct platform_work_queue;
+#define PLATFORM_WORK_QUEUE_CALLBACK(Name) void Name(platform_work_queue *Queue, void *Data)
+typedef PLATFORM_WORK_QUEUE_CALLBACK(platform_work_queue_callback);
+
+// Only the main thread adds work. CompleteAllWork has the main thread
+// help drain the queue and returns once every added entry has run.
+static void PlatformAddWorkEntry(platform_work_queue *Queue, platform_work_queue_callback *Callback, void *Data);
+static void PlatformCompleteAllWork(platform_work_queue *Queue);
+
+// Returns the value before the add
+static u32 PlatformAtomicAdd(volatile u32 *Value, u32 Addend);
+// Full barrier, every write before it is visible once the new value is.
+// Returns the old value.
+static u32 PlatformAtomicExchange(volatile u32 *Value, u32 New);
+// Full barrier, stores New only if Value was Expected. Returns the old
+// value either way.
+static u32 PlatformAtomicCompareExchange(volatile u32 *Value, u32 New, u32 Expected);
+
+// Seconds since an arbitrary fixed point, for timing
+static f64 PlatformGetSeconds();
+static void PlatformSleep(u32 Milliseconds);
+
+// Succeeds if the directory already exists
+static b32 PlatformCreateDirectory(char *Path);
+
 struct entire_file {
     char *Contents;
     size_t Size;
 };
 
-static inline entire_file ReadEntireFile(char *Filename) {
+static inline entire_file ReadEntireFile(char *Filename, b32 MissingIsError = true) {
     entire_file Result = {};
     FILE *File = fopen(Filename, "rb");
     if (File) {
@@ -21,14 +46,33 @@ static inline entire_file ReadEntireFile(char *Filename) {
         Result.Contents = (char *)malloc(Result.Size + 1);
         fread(Result.Contents, 1, Result.Size, File);
         Result.Contents[Result.Size] = '\0';
+        fclose(File);
     }
-    else {
+    else if (MissingIsError) {
         LERROR("Failed to load file %s.", Filename);
     }
     return Result;
 }
 
+static inline b32 WriteEntireFile(char *Filename, void *Data, size_t Size) {
+    b32 Result = false;
+    FILE *File = fopen(Filename, "wb");
+    if (File) {
+        Result = (fwrite(Data, 1, Size, File) == Size);
+        fclose(File);
+    }
+    if (!Result) {
+        LERROR("Failed to write file %s.", Filename);
+    }
+    return Result;
+}
+
 static inline void FreeEntireFile(entire_file File) {
     Assert(File.Contents);
     free(File.Contents);
 }
+
+// Read-only view of the whole file, Contents stays valid until it's
+// unmapped. Pages are only read in as they're touched.
+static entire_file PlatformMapFile(const char *Filename, b32 MissingIsError = true);
+static void PlatformUnmapFile(void *Contents);
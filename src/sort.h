@@ -0,0 +1,47 @@
+#pragma once
+
+struct sort_entry {
+    u32 SortKey;
+    u32 Index;
+};
+
+// Maps a float to a key that sorts in the same order as unsigned ints.
+// Positives get the sign bit set, negatives have every bit flipped.
+static inline u32 SortKeyFromF32(f32 Value) {
+    union {
+        f32 F;
+        u32 U;
+    } Bits;
+    Bits.F = Value;
+    u32 Mask = (Bits.U & 0x80000000) ? 0xFFFFFFFF : 0x80000000;
+    return Bits.U ^ Mask;
+}
+
+// LSD radix sort on 8 bits at a time. Temp must hold Count entries.
+// An even number of passes leaves the sorted result back in First.
+static void RadixSort(u32 Count, sort_entry *First, sort_entry *Temp) {
+    sort_entry *Source = First;
+    sort_entry *Dest = Temp;
+    for (u32 ByteIndex = 0; ByteIndex < 32; ByteIndex += 8) {
+        u32 Offsets[256] = {};
+        for (u32 i = 0; i < Count; ++i) {
+            ++Offsets[(Source[i].SortKey >> ByteIndex) & 0xFF];
+        }
+
+        u32 Total = 0;
+        for (u32 i = 0; i < ArrayCount(Offsets); ++i) {
+            u32 BucketCount = Offsets[i];
+            Offsets[i] = Total;
+            Total += BucketCount;
+        }
+
+        for (u32 i = 0; i < Count; ++i) {
+            u32 Bucket = (Source[i].SortKey >> ByteIndex) & 0xFF;
+            Dest[Offsets[Bucket]++] = Source[i];
+        }
+
+        sort_entry *Swap = Source;
+        Source = Dest;
+        Dest = Swap;
+    }
+}
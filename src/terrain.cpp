@@ -0,0 +1,229 @@
+#pragma once
+
+//
+// Terrain
+//
+// Heights are stb_perlin fBm, sampled at each vertex's world position, so
+// neighbouring chunks agree on their shared edge without knowing about
+// each other. Chunks are generated into per-slot storage on the
+// background queue and stay there while resident. Each chunk in use is
+// registered as "terrain/<x>,<y>" for a renderer slot, its geometry
+// stays in the chunk's own storage.
+//
+#define TERRAIN_BASE_HEIGHT -8.f
+#define TERRAIN_AMPLITUDE 4.f
+#define TERRAIN_FREQUENCY 0.04f
+#define TERRAIN_LACUNARITY 2.f
+#define TERRAIN_GAIN 0.5f
+#define TERRAIN_OCTAVES 6
+
+static void InitTerrain(terrain *Terrain, memory_arena *Arena) {
+    *Terrain = {};
+    for (u32 i = 0; i < ArrayCount(Terrain->Chunks); ++i) {
+        mesh_object *Mesh = &Terrain->Chunks[i].Mesh;
+        Mesh->Vertices = PushArray(Arena, vertex, TERRAIN_CHUNK_VERTEX_COUNT);
+        Mesh->Indices = PushArray(Arena, u16, TERRAIN_CHUNK_INDEX_COUNT);
+        Assert(Mesh->Vertices && Mesh->Indices);
+    }
+}
+
+static inline vec4 GetTerrainColor(f32 Height) {
+    f32 t = (Height - (TERRAIN_BASE_HEIGHT - TERRAIN_AMPLITUDE))/(2.f*TERRAIN_AMPLITUDE);
+    t = (t < 0.f) ? 0.f : ((t > 1.f) ? 1.f : t);
+    vec4 Low = vec4(0.15f, 0.35f, 0.15f, 1.f);
+    vec4 High = vec4(0.75f, 0.7f, 0.6f, 1.f);
+    vec4 Result = vec4(Low.x + t*(High.x - Low.x), Low.y + t*(High.y - Low.y), Low.z + t*(High.z - Low.z), 1.f);
+    return Result;
+}
+
+// Runs on a worker. Only touches the chunk, and publishes it with the
+// state change last.
+static PLATFORM_WORK_QUEUE_CALLBACK(GenerateTerrainChunk) {
+    terrain_chunk *Chunk = (terrain_chunk *)Data;
+    Assert(Chunk->State == TERRAIN_CHUNK_GENERATING);
+
+    mesh_object *Mesh = &Chunk->Mesh;
+    u32 Side = TERRAIN_CHUNK_QUAD_COUNT + 1;
+    f32 Spacing = TERRAIN_CHUNK_SIZE/TERRAIN_CHUNK_QUAD_COUNT;
+    f32 OriginX = Chunk->X*TERRAIN_CHUNK_SIZE;
+    f32 OriginY = Chunk->Y*TERRAIN_CHUNK_SIZE;
+    for (u32 j = 0; j < Side; ++j) {
+        for (u32 i = 0; i < Side; ++i) {
+            f32 x = OriginX + i*Spacing;
+            f32 y = OriginY + j*Spacing;
+            f32 Height = TERRAIN_BASE_HEIGHT + TERRAIN_AMPLITUDE*stb_perlin_fbm_noise3(
+                    TERRAIN_FREQUENCY*x, TERRAIN_FREQUENCY*y, 0.f, TERRAIN_LACUNARITY, TERRAIN_GAIN, TERRAIN_OCTAVES);
+
+            vertex *Vertex = Mesh->Vertices + j*Side + i;
+            Vertex->Position = vec3(x, y, Height);
+            Vertex->Color = GetTerrainColor(Height);
+            Vertex->UV = vec2((f32)i/TERRAIN_CHUNK_QUAD_COUNT, (f32)j/TERRAIN_CHUNK_QUAD_COUNT);
+        }
+    }
+
+    // Same winding as CreatePlane
+    u16 *Indices = Mesh->Indices;
+    for (u32 j = 0; j < TERRAIN_CHUNK_QUAD_COUNT; ++j) {
+        for (u32 i = 0; i < TERRAIN_CHUNK_QUAD_COUNT; ++i) {
+            u16 Corner = (u16)(j*Side + i);
+            *Indices++ = Corner;
+            *Indices++ = Corner + 1;
+            *Indices++ = Corner + 1 + Side;
+            *Indices++ = Corner + 1 + Side;
+            *Indices++ = Corner + Side;
+            *Indices++ = Corner;
+        }
+    }
+
+    Mesh->VertexCount = TERRAIN_CHUNK_VERTEX_COUNT;
+    Mesh->IndexCount = TERRAIN_CHUNK_INDEX_COUNT;
+    InitSinglePartMesh(Mesh);
+    PlatformAtomicExchange(&Chunk->State, TERRAIN_CHUNK_GENERATED);
+}
+
+static inline i32 GetTerrainChunkCoordinate(f32 Value) {
+    i32 Result = (i32)floorf(Value/TERRAIN_CHUNK_SIZE);
+    return Result;
+}
+
+static inline i32 GetChunkDistance(terrain_chunk *Chunk, i32 X, i32 Y) {
+    i32 dX = (Chunk->X > X) ? Chunk->X - X : X - Chunk->X;
+    i32 dY = (Chunk->Y > Y) ? Chunk->Y - Y : Y - Chunk->Y;
+    return (dX > dY) ? dX : dY;
+}
+
+// Retired chunks still hold their name until the delete is through, a
+// chunk coming back into range waits for that before it's generated again
+static terrain_chunk *FindTerrainChunk(terrain *Terrain, i32 X, i32 Y) {
+    for (u32 i = 0; i < ArrayCount(Terrain->Chunks); ++i) {
+        terrain_chunk *Chunk = Terrain->Chunks + i;
+        if (Chunk->State != TERRAIN_CHUNK_FREE && Chunk->X == X && Chunk->Y == Y) {
+            return Chunk;
+        }
+    }
+    return 0;
+}
+
+// Called once a frame from the main thread. Uploads finished chunks,
+// drops far ones, and starts jobs for missing chunks nearest first.
+// Without a background queue chunks are generated inline.
+static void UpdateTerrain(terrain *Terrain, assets *Assets, platform_work_queue *Queue, render_commands *Commands, vec3 CameraP) {
+    i32 CameraX = GetTerrainChunkCoordinate(CameraP.x);
+    i32 CameraY = GetTerrainChunkCoordinate(CameraP.y);
+
+    u32 JobsInFlight = 0;
+    u32 UploadCount = 0;
+    for (u32 i = 0; i < ArrayCount(Terrain->Chunks); ++i) {
+        terrain_chunk *Chunk = Terrain->Chunks + i;
+        b32 Far = (GetChunkDistance(Chunk, CameraX, CameraY) > TERRAIN_DROP_RADIUS);
+        switch (Chunk->State) {
+            case TERRAIN_CHUNK_GENERATING: {
+                ++JobsInFlight;
+            } break;
+
+            case TERRAIN_CHUNK_GENERATED: {
+                if (Far) {
+                    ReleaseMesh(Assets, Chunk->Handle);
+                    Chunk->State = TERRAIN_CHUNK_FREE;
+                }
+                else if (UploadCount < MAX_TERRAIN_UPLOADS_PER_FRAME) {
+                    upload_work Work = {};
+                    Work.Operation = UPLOAD_OPERATION_CREATE;
+                    Work.Slot = Chunk->Handle.Slot;
+                    Work.Mesh = &Chunk->Mesh;
+                    Work.Completed = &Chunk->UploadCompleted;
+                    Chunk->UploadCompleted = false;
+                    if (PushUploadWork(Commands->UploadQueue, &Work)) {
+                        Chunk->State = TERRAIN_CHUNK_UPLOADING;
+                        ++UploadCount;
+                    }
+                }
+            } break;
+
+            case TERRAIN_CHUNK_UPLOADING: {
+                // Far chunks finish uploading first, their delete has to
+                // queue behind the upload anyway
+                if (Chunk->UploadCompleted) {
+                    Chunk->State = TERRAIN_CHUNK_RESIDENT;
+                }
+            } break;
+
+            case TERRAIN_CHUNK_RESIDENT: {
+                if (Far) {
+                    upload_work Work = {};
+                    Work.Operation = UPLOAD_OPERATION_DELETE;
+                    Work.Slot = Chunk->Handle.Slot;
+                    Work.Completed = &Chunk->UploadCompleted;
+                    Chunk->UploadCompleted = false;
+                    if (PushUploadWork(Commands->UploadQueue, &Work)) {
+                        Chunk->State = TERRAIN_CHUNK_RETIRED;
+                    }
+                }
+            } break;
+
+            case TERRAIN_CHUNK_RETIRED: {
+                // Once the delete is through nothing refers to the storage
+                // or the slot anymore
+                if (Chunk->UploadCompleted) {
+                    ReleaseMesh(Assets, Chunk->Handle);
+                    Chunk->State = TERRAIN_CHUNK_FREE;
+                }
+            } break;
+
+            default: break;
+        }
+    }
+
+    // Rings outwards from the camera's chunk
+    u32 NextFreeSlot = 0;
+    for (i32 Ring = 0; Ring <= TERRAIN_LOAD_RADIUS && JobsInFlight < MAX_TERRAIN_JOBS_IN_FLIGHT; ++Ring) {
+        for (i32 Y = CameraY - Ring; Y <= CameraY + Ring; ++Y) {
+            for (i32 X = CameraX - Ring; X <= CameraX + Ring; ++X) {
+                b32 OnRing = (X == CameraX - Ring || X == CameraX + Ring || Y == CameraY - Ring || Y == CameraY + Ring);
+                if (!OnRing || JobsInFlight >= MAX_TERRAIN_JOBS_IN_FLIGHT || FindTerrainChunk(Terrain, X, Y)) {
+                    continue;
+                }
+
+                while (NextFreeSlot < ArrayCount(Terrain->Chunks) && Terrain->Chunks[NextFreeSlot].State != TERRAIN_CHUNK_FREE) {
+                    ++NextFreeSlot;
+                }
+                if (NextFreeSlot == ArrayCount(Terrain->Chunks)) {
+                    // Far chunks still finishing, try again next frame
+                    return;
+                }
+                char Name[64];
+                snprintf(Name, sizeof(Name), "terrain/%d,%d", X, Y);
+                mesh_handle Handle = RegisterMesh(Assets, Name);
+                if (!GetMesh(Assets, Handle)) {
+                    return;
+                }
+                terrain_chunk *Chunk = Terrain->Chunks + NextFreeSlot;
+                Chunk->Handle = Handle;
+                Chunk->X = X;
+                Chunk->Y = Y;
+                Chunk->State = TERRAIN_CHUNK_GENERATING;
+                if (Queue) {
+                    PlatformAddWorkEntry(Queue, GenerateTerrainChunk, Chunk);
+                }
+                else {
+                    GenerateTerrainChunk(NULL, Chunk);
+                }
+                ++JobsInFlight;
+            }
+        }
+    }
+}
+
+// Resident chunks are drawn whole, they're flat enough that a LOD
+// chain isn't worth the worker time yet
+static void PushTerrain(terrain *Terrain, render_commands *Commands) {
+    for (u32 i = 0; i < ArrayCount(Terrain->Chunks); ++i) {
+        if (Terrain->Chunks[i].State == TERRAIN_CHUNK_RESIDENT) {
+            render_entry_mesh *Entry = PushRenderEntry(Commands, render_entry_mesh);
+            if (Entry) {
+                Entry->Slot = Terrain->Chunks[i].Handle.Slot;
+                Entry->LOD = 0;
+            }
+        }
+    }
+}
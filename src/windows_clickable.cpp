@@ -30,6 +30,8 @@
 #include <stdio.h> // vsnprintf
 #include <math.h> // sqrtf, tanf
 #include <float.h>
+#include <string.h> // strcmp
+#include <xmmintrin.h> // SSE, BVH triangle tests
 
 #include "defines.h"
 #include "log.h"
@@ -38,7 +40,14 @@
 #include "arena.h"
 #include "input.h"
 #include "random.h"
+#include "hash.h"
+#include "sort.h"
+#define CGLTF_IMPLEMENTATION
+#include "../ext/cgltf.h"
+#define STB_PERLIN_IMPLEMENTATION
+#include "../ext/stb/stb_perlin.h"
 #include "clickable.h"
+#include "asset_pack.h"
 #include "opengl_functions.h"
 #include "opengl_renderer.h"
 
@@ -47,18 +56,89 @@ static u32 GlobalScreenHeight;
 static b32 GlobalRunning = true;
 static vec2 GlobalMouseP;
 
+#include "mesh_optimizer.cpp"
+#include "mesh_simplifier.cpp"
+#include "assets.cpp"
+#include "mesh_bvh.cpp"
 #include "clickable.cpp"
 #include "opengl_renderer.cpp"
 #include "windows_opengl.cpp"
+#include "windows_frame_pacing.cpp"
+#include "windows_platform.cpp"
+
+#define BACKGROUND_WORKER_THREAD_COUNT 2
+struct platform_work_queue_entry {
+    platform_work_queue_callback *Callback;
+    void *Data;
+};
+
+struct platform_work_queue {
+    u32 volatile CompletionGoal;
+    u32 volatile CompletionCount;
+
+    u32 volatile NextEntryToWrite;
+    u32 volatile NextEntryToRead;
+    HANDLE SemaphoreHandle;
+
+    platform_work_queue_entry Entries[256];
+};
+
+static void PlatformAddWorkEntry(platform_work_queue *Queue, platform_work_queue_callback *Callback, void *Data) {
+    u32 NewNextEntryToWrite = (Queue->NextEntryToWrite + 1) % ArrayCount(Queue->Entries);
+    Assert(NewNextEntryToWrite != Queue->NextEntryToRead);
+    platform_work_queue_entry *Entry = Queue->Entries + Queue->NextEntryToWrite;
+    Entry->Callback = Callback;
+    Entry->Data = Data;
+    ++Queue->CompletionGoal;
+    _WriteBarrier();
+    Queue->NextEntryToWrite = NewNextEntryToWrite;
+    ReleaseSemaphore(Queue->SemaphoreHandle, 1, 0);
+}
+
+static b32 DoNextWorkQueueEntry(platform_work_queue *Queue) {
+    b32 ShouldSleep = false;
+
+    u32 OriginalNextEntryToRead = Queue->NextEntryToRead;
+    u32 NewNextEntryToRead = (OriginalNextEntryToRead + 1) % ArrayCount(Queue->Entries);
+    if (OriginalNextEntryToRead != Queue->NextEntryToWrite) {
+        u32 Index = InterlockedCompareExchange((LONG volatile *)&Queue->NextEntryToRead, NewNextEntryToRead, OriginalNextEntryToRead);
+        if (Index == OriginalNextEntryToRead) {
+            platform_work_queue_entry Entry = Queue->Entries[Index];
+            Entry.Callback(Queue, Entry.Data);
+            InterlockedIncrement((LONG volatile *)&Queue->CompletionCount);
+        }
+    }
+    else {
+        ShouldSleep = true;
+    }
+    return ShouldSleep;
+}
+
+static void PlatformCompleteAllWork(platform_work_queue *Queue) {
+    while (Queue->CompletionGoal != Queue->CompletionCount) {
+        DoNextWorkQueueEntry(Queue);
+    }
+    Queue->CompletionGoal = 0;
+    Queue->CompletionCount = 0;
+}
+
+DWORD WINAPI WorkerThreadProc(LPVOID Parameter) {
+    platform_work_queue *Queue = (platform_work_queue *)Parameter;
+    for (;;) {
+        if (DoNextWorkQueueEntry(Queue)) {
+            WaitForSingleObjectEx(Queue->SemaphoreHandle, INFINITE, FALSE);
+        }
+    }
+}
 
-// for hot reload code, I could expose these functions and pass them to the lib
-// by calling a library function which hooks these definitions
-static void *PlatformAllocate(size_t Size) {
-    void *Result = VirtualAlloc(0, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
-    if (!Result) {
-        Assert(!"Allocate memory failed");
+static void MakeWorkQueue(platform_work_queue *Queue, u32 ThreadCount) {
+    *Queue = {};
+    Queue->SemaphoreHandle = CreateSemaphoreExA(0, 0, ThreadCount, 0, 0, SEMAPHORE_ALL_ACCESS);
+    for (u32 i = 0; i < ThreadCount; ++i) {
+        DWORD ThreadID;
+        HANDLE ThreadHandle = CreateThread(0, 0, WorkerThreadProc, Queue, 0, &ThreadID);
+        CloseHandle(ThreadHandle);
     }
-    return Result;
 }
 
 static void PlatformMessageBox(const char *Message, ...) {
@@ -143,6 +223,27 @@ static void ProcessMessages(HWND Window, program_input *Input) {
                     else if (Message.wParam == 'D') {
                         UpdateButton(BUTTON_KEY_D, Input, IsUp);
                     }
+                    else if (Message.wParam == 'R') {
+                        UpdateButton(BUTTON_KEY_R, Input, IsUp);
+                    }
+                    else if (Message.wParam == 'M') {
+                        UpdateButton(BUTTON_KEY_M, Input, IsUp);
+                    }
+                    else if (Message.wParam == 'O') {
+                        UpdateButton(BUTTON_KEY_O, Input, IsUp);
+                    }
+                    else if (Message.wParam == 'V') {
+                        UpdateButton(BUTTON_KEY_V, Input, IsUp);
+                    }
+                    else if (Message.wParam == 'L') {
+                        UpdateButton(BUTTON_KEY_L, Input, IsUp);
+                    }
+                    else if (Message.wParam == 'F') {
+                        UpdateButton(BUTTON_KEY_F, Input, IsUp);
+                    }
+                    else if (Message.wParam == 'G') {
+                        UpdateButton(BUTTON_KEY_G, Input, IsUp);
+                    }
                     else if (Message.wParam == VK_LEFT) {
                         UpdateButton(BUTTON_KEY_LEFT, Input, IsUp);
                     }
@@ -204,13 +305,29 @@ int WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PTSTR CommandLine, int C
     );
 
     if (Window) {
+        f64 StartupBeginSeconds = PlatformGetSeconds();
         HDC DC = GetDC(Window);
         opengl *OpenGL = WindowsInitOpenGL(DC);
         if (OpenGL) {
 
+            SYSTEM_INFO SystemInfo;
+            GetSystemInfo(&SystemInfo);
+            u32 WorkerThreadCount = SystemInfo.dwNumberOfProcessors > 1 ? SystemInfo.dwNumberOfProcessors - 1 : 1;
+            if (WorkerThreadCount > MAX_CIRCLE_JOB_COUNT) {
+                WorkerThreadCount = MAX_CIRCLE_JOB_COUNT;
+            }
+            platform_work_queue WorkQueue;
+            MakeWorkQueue(&WorkQueue, WorkerThreadCount);
+            // Terrain generation and the like, kept off the per-frame
+            // queue since PlatformCompleteAllWork would wait for it
+            platform_work_queue BackgroundQueue;
+            MakeWorkQueue(&BackgroundQueue, BACKGROUND_WORKER_THREAD_COUNT);
+
             program_memory Memory = {};
             Memory.PersistantMemorySize = 1*GiB;
             Memory.PersistantMemory = PlatformAllocate(Memory.PersistantMemorySize);
+            Memory.WorkQueue = &WorkQueue;
+            Memory.BackgroundQueue = &BackgroundQueue;
 
             program_input _Input = {};
             program_input *Input = &_Input;
@@ -221,10 +338,29 @@ int WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PTSTR CommandLine, int C
             QueryPerformanceFrequency(&CounterFrequencyResult);
             i64 CounterFrequency = CounterFrequencyResult.QuadPart;
 
+            frame_pacing Pacing;
+            InitFramePacing(&Pacing, CounterFrequency);
+            b32 FirstFrame = true;
+
             while (GlobalRunning) {
 
+                // Wait before reading input, so whatever is sampled is as
+                // fresh as possible when the frame reaches the GPU
+                WaitForFrameSlot(&Pacing);
                 ProcessMessages(Window, Input);
 
+                if (ButtonPressed(Input, BUTTON_KEY_V)) {
+                    CycleSwapInterval(&Pacing);
+                }
+                if (ButtonPressed(Input, BUTTON_KEY_F)) {
+                    Pacing.MaxFramesInFlight = (Pacing.MaxFramesInFlight % MAX_FRAMES_IN_FLIGHT) + 1;
+                    LINFO("Max frames in flight: %u", Pacing.MaxFramesInFlight);
+                }
+                if (ButtonPressed(Input, BUTTON_KEY_L)) {
+                    Pacing.LateLatch = !Pacing.LateLatch;
+                    LINFO("Late latch: %s", Pacing.LateLatch ? "on" : "off");
+                }
+
                 LARGE_INTEGER BeginFrameCounter;
                 QueryPerformanceCounter(&BeginFrameCounter);
                 i64 CounterElapsed = BeginFrameCounter.QuadPart - LastFrameCounter.QuadPart;
@@ -233,11 +369,46 @@ int WinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PTSTR CommandLine, int C
 
                 render_commands Commands = BeginFrame(OpenGL);
                 UpdateAndRender(&Memory, &Commands, Input, Frametime);
-                u32 DrawCalls = EndFrame(OpenGL, &Commands);
+
+                LARGE_INTEGER InputCounter = BeginFrameCounter;
+                if (Pacing.LateLatch) {
+                    LateLatchMouse(Window);
+                    LateLatchDrag(&Memory);
+                    QueryPerformanceCounter(&InputCounter);
+                }
+                render_stats Stats = EndFrame(OpenGL, &Commands);
+
+                LARGE_INTEGER EndWorkCounter;
+                QueryPerformanceCounter(&EndWorkCounter);
+                f64 WorkSeconds = (f64)(EndWorkCounter.QuadPart - BeginFrameCounter.QuadPart)/CounterFrequency;
+                // GPU times lag a couple of frames behind, but whichever
+                // side is slower decides whether the frame fits the budget
+                f64 GPUSeconds = Stats.GPUFrameMs/1000.0;
+                f64 BusySeconds = (GPUSeconds > WorkSeconds) ? GPUSeconds : WorkSeconds;
+                UpdateDynamicResolution(OpenGL, BusySeconds);
+
                 SwapBuffers(DC);
+                EndFramePacing(&Pacing, InputCounter.QuadPart);
+                if (FirstFrame) {
+                    FirstFrame = false;
+                    LINFO("Time to first frame: %.2fms.", 1000.0*(PlatformGetSeconds() - StartupBeginSeconds));
+                }
 
-                char Title[256] = {};
-                sprintf(Title, "Clickable | Circles: %u | fps: %.0f | Draws: %u", Commands.CircleCount, (f32)(1.f/Frametime), DrawCalls);
+                char Title[512] = {};
+                sprintf(Title, "Clickable | Circles: %u | fps: %.0f | Draws: %u | Scale: %.2f (%ux%u) %s | Frags: %.2fM"
+                        " | CPU: %.2fms GPU: %.2fms (upload %.2f, scene %.2f, resolve %.2f, present %.2f)"
+                        " | Latency: %.1fms (swap %d, in flight %u, late latch %s)"
+                        " | Meshes: %.2f/%.2fMB (%u evicted, %u tris)",
+                        Commands.CircleCount, (f32)(1.f/Frametime), Stats.DrawCalls,
+                        Stats.RenderScale, Stats.RenderWidth, Stats.RenderHeight,
+                        Stats.DirectResolve ? "direct" : "scaled",
+                        (f32)Stats.FragmentInvocations/1000000.f,
+                        (f32)(1000.0*WorkSeconds), Stats.GPUFrameMs,
+                        Stats.GPUPassMs[GPU_PASS_UPLOAD], Stats.GPUPassMs[GPU_PASS_SCENE],
+                        Stats.GPUPassMs[GPU_PASS_RESOLVE], Stats.GPUPassMs[GPU_PASS_PRESENT],
+                        Pacing.FilteredLatencyMs, Pacing.SwapInterval, Pacing.MaxFramesInFlight,
+                        Pacing.LateLatch ? "on" : "off",
+                        (f32)Stats.MeshResidentBytes/MiB, (f32)Stats.MeshBudgetBytes/MiB, Stats.MeshEvictions, Stats.MeshTriangles);
                 SetWindowText(Window, Title);
 
                 program_input TempInput = _Input;
@@ -0,0 +1,179 @@
+/* *
+ * Asset cooker
+ *
+ * Builds everything LoadAssets would otherwise build at startup and writes
+ * it as one asset pack (see asset_pack.h):
+ *
+ *     cooker <output pack> [model.glb ...]
+ *
+ * The procedural plane is cooked as "test_object". Each model's meshes are
+ * cooked as "<file name without extension>/<n>" in load order, so
+ * ass/models/scene.glb becomes "scene/0", "scene/1", ... Every mesh goes
+ * through the mesh optimizer and gets its LOD chain first.
+ *
+ * */
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include <stdio.h> // vsnprintf
+#include <math.h> // sqrtf, tanf
+#include <float.h>
+#include <string.h> // strcmp
+
+#include "defines.h"
+#include "log.h"
+#include "platform.h"
+#include "maths.h"
+#include "arena.h"
+#include "input.h"
+#include "random.h"
+#include "hash.h"
+#include "sort.h"
+#define CGLTF_IMPLEMENTATION
+#include "../ext/cgltf.h"
+#include "clickable.h"
+#include "asset_pack.h"
+
+#include "mesh_optimizer.cpp"
+#include "mesh_simplifier.cpp"
+#include "assets.cpp"
+#include "windows_platform.cpp"
+
+static void PlatformMessageBox(const char *Message, ...) {
+    va_list Args;
+    va_start(Args, Message);
+    vfprintf(stderr, Message, Args);
+    va_end(Args);
+}
+
+static void PlatformDebugPrint(const char *Message, ...) {
+    va_list Args;
+    va_start(Args, Message);
+    vprintf(Message, Args);
+    va_end(Args);
+}
+
+struct cooked_mesh {
+    char Name[64];
+    mesh_object *Mesh;
+};
+
+static b32 WriteAssetPack(char *Path, cooked_mesh *Meshes, u32 MeshCount) {
+    asset_pack_entry *Entries = (asset_pack_entry *)calloc(MeshCount ? MeshCount : 1, sizeof(asset_pack_entry));
+    if (!Entries) {
+        LERROR("Failed to allocate %u pack entries.", MeshCount);
+        return false;
+    }
+
+    // Lay out the entries first, blobs follow in cook order
+    u64 Offset = sizeof(asset_pack_header);
+    u64 EntriesOffset = AlignPackOffset(Offset);
+    Offset = EntriesOffset + MeshCount*sizeof(asset_pack_entry);
+    for (u32 i = 0; i < MeshCount; ++i) {
+        mesh_object *Mesh = Meshes[i].Mesh;
+        asset_pack_entry *Entry = Entries + i;
+        Entry->NameHash = HashString(Meshes[i].Name);
+        Entry->VertexCount = Mesh->VertexCount;
+        Entry->IndexCount = Mesh->IndexCount;
+        Entry->PartCount = Mesh->PartCount;
+        Entry->LODCount = Mesh->LODCount;
+        memcpy(Entry->Parts, Mesh->Parts, sizeof(Entry->Parts));
+        memcpy(Entry->LODs, Mesh->LODs, sizeof(Entry->LODs));
+        Entry->VertexOffset = AlignPackOffset(Offset);
+        Offset = Entry->VertexOffset + Mesh->VertexCount*sizeof(vertex);
+        Entry->IndexOffset = AlignPackOffset(Offset);
+        Offset = Entry->IndexOffset + Mesh->IndexCount*sizeof(u16);
+    }
+    size_t PackSize = (size_t)Offset;
+
+    u8 *Pack = (u8 *)calloc(1, PackSize);
+    if (!Pack) {
+        LERROR("Failed to allocate %zu bytes for the pack.", PackSize);
+        free(Entries);
+        return false;
+    }
+    for (u32 i = 0; i < MeshCount; ++i) {
+        mesh_object *Mesh = Meshes[i].Mesh;
+        memcpy(Pack + Entries[i].VertexOffset, Mesh->Vertices, Mesh->VertexCount*sizeof(vertex));
+        memcpy(Pack + Entries[i].IndexOffset, Mesh->Indices, Mesh->IndexCount*sizeof(u16));
+    }
+
+    // Sorted by hash for the binary search in LoadPackedMesh
+    for (u32 i = 1; i < MeshCount; ++i) {
+        asset_pack_entry Entry = Entries[i];
+        u32 j = i;
+        for (; j > 0 && Entries[j - 1].NameHash > Entry.NameHash; --j) {
+            Entries[j] = Entries[j - 1];
+        }
+        Entries[j] = Entry;
+    }
+    for (u32 i = 1; i < MeshCount; ++i) {
+        if (Entries[i].NameHash == Entries[i - 1].NameHash) {
+            LERROR("Two meshes hash to %016llx, rename one of them.", (unsigned long long)Entries[i].NameHash);
+            free(Pack);
+            free(Entries);
+            return false;
+        }
+    }
+
+    asset_pack_header *Header = (asset_pack_header *)Pack;
+    Header->Magic = ASSET_PACK_MAGIC;
+    Header->Version = ASSET_PACK_VERSION;
+    Header->VertexSize = sizeof(vertex);
+    Header->EntryCount = MeshCount;
+    Header->EntriesOffset = EntriesOffset;
+    memcpy(Pack + EntriesOffset, Entries, MeshCount*sizeof(asset_pack_entry));
+
+    b32 Result = WriteEntireFile(Path, Pack, PackSize);
+    if (Result) {
+        LINFO("Wrote %s, %u meshes in %zu bytes.", Path, MeshCount, PackSize);
+    }
+    free(Pack);
+    free(Entries);
+    return Result;
+}
+
+int main(int ArgCount, char **Args) {
+    if (ArgCount < 2) {
+        PlatformMessageBox("Usage: %s <output pack> [model.glb ...]\n", Args[0]);
+        return 1;
+    }
+
+    size_t ArenaSize = 64*MiB;
+    memory_arena Arena = CreateArena(PlatformAllocate(ArenaSize), ArenaSize);
+    assets *Assets = PushStruct(&Arena, assets);
+    *Assets = {};
+    InitAssetStore(Assets, &Arena);
+
+    cooked_mesh *Cooked = PushArray(&Arena, cooked_mesh, MAX_MESH_COUNT);
+    Assert(Cooked);
+    u32 CookedCount = 0;
+
+    // Same seed as the game, so the cooked plane matches a runtime one
+    random_series Series = InitRandom(12);
+    mesh_object *Plane = GetMesh(Assets, RegisterMesh(Assets, "test_object"));
+    Assert(Plane);
+    CreatePlane(Assets, &Series, Plane, vec3(), 8.f, 6.f, 24);
+    if (Plane->Vertices) {
+        snprintf(Cooked[CookedCount].Name, sizeof(Cooked[CookedCount].Name), "test_object");
+        Cooked[CookedCount++].Mesh = Plane;
+    }
+
+    for (int ArgIndex = 2; ArgIndex < ArgCount; ++ArgIndex) {
+        char *ModelPath = Args[ArgIndex];
+        // Copied so every mesh can be optimized before it's packed
+        loaded_model *Model = LoadModel(Assets, ModelPath, true, true);
+        if (!Model) {
+            return 1;
+        }
+        char Stem[48];
+        GetFileStem(ModelPath, Stem, sizeof(Stem));
+        for (u32 i = 0; i < Model->MeshCount; ++i) {
+            cooked_mesh *Entry = Cooked + CookedCount++;
+            snprintf(Entry->Name, sizeof(Entry->Name), "%s/%u", Stem, i);
+            Entry->Mesh = GetMesh(Assets, Assets->ModelMeshes[Model->FirstMesh + i]);
+        }
+    }
+
+    return WriteAssetPack(Args[1], Cooked, CookedCount) ? 0 : 1;
+}
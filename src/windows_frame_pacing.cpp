@@ -0,0 +1,158 @@
+#pragma once
+
+//
+// Frame pacing
+//
+// Owns the swap interval and keeps the CPU at most MaxFramesInFlight
+// frames ahead of the GPU, waiting on a fence placed after each swap.
+// Latency is measured from the frame's last input sample to the moment
+// its fence is seen signaled, so it's an upper bound on input to
+// GPU-complete and doesn't include scanout.
+//
+#define MAX_FRAMES_IN_FLIGHT 3
+#define FRAME_PACING_WAIT_TIMEOUT_NS 100000000ull
+#define FRAME_PACING_LATENCY_FILTER 0.1f
+
+struct frame_pacing {
+    wgl_swap_interval_ext *wglSwapIntervalEXT;
+    b32 HasAdaptiveVSync;
+    // 1 is vsync, 0 is off, -1 is adaptive: vsync unless the frame
+    // missed the interval, in which case it tears instead of waiting
+    i32 SwapInterval;
+
+    b32 HasFences;
+    u32 MaxFramesInFlight;
+    GLsync Fences[MAX_FRAMES_IN_FLIGHT];
+    i64 InputCounters[MAX_FRAMES_IN_FLIGHT];
+    u32 FrameIndex;
+
+    // Resample the mouse right before submitting and move the dragged
+    // circle to it
+    b32 LateLatch;
+
+    i64 CounterFrequency;
+    f32 LatencyMs;
+    f32 FilteredLatencyMs;
+};
+
+static void SetSwapInterval(frame_pacing *Pacing, i32 Interval) {
+    if (Interval < 0 && !Pacing->HasAdaptiveVSync) {
+        Interval = 1;
+    }
+    if (Pacing->wglSwapIntervalEXT) {
+        Pacing->wglSwapIntervalEXT(Interval);
+        Pacing->SwapInterval = Interval;
+    }
+}
+
+static void InitFramePacing(frame_pacing *Pacing, i64 CounterFrequency) {
+    *Pacing = {};
+    Pacing->CounterFrequency = CounterFrequency;
+    Pacing->MaxFramesInFlight = 2;
+    Pacing->LateLatch = true;
+    Pacing->HasFences = (glFenceSync && glClientWaitSync && glDeleteSync);
+
+    Pacing->wglSwapIntervalEXT = (wgl_swap_interval_ext *)wglGetProcAddress("wglSwapIntervalEXT");
+    wgl_get_extensions_string_ext *wglGetExtensionsStringEXT = (wgl_get_extensions_string_ext *)wglGetProcAddress("wglGetExtensionsStringEXT");
+    if (wglGetExtensionsStringEXT) {
+        const char *Extensions = wglGetExtensionsStringEXT();
+        Pacing->HasAdaptiveVSync = (Extensions && strstr(Extensions, "WGL_EXT_swap_control_tear") != NULL);
+    }
+
+    if (Pacing->wglSwapIntervalEXT) {
+        SetSwapInterval(Pacing, 1);
+    }
+    else {
+        LINFO("No VSync support.");
+    }
+    if (!Pacing->HasFences) {
+        LINFO("No fence sync support, frames in flight are not limited.");
+    }
+}
+
+// Cycles vsync, off, and adaptive when the driver supports it
+static void CycleSwapInterval(frame_pacing *Pacing) {
+    i32 Next = 1;
+    if (Pacing->SwapInterval == 1) {
+        Next = 0;
+    }
+    else if (Pacing->SwapInterval == 0 && Pacing->HasAdaptiveVSync) {
+        Next = -1;
+    }
+    SetSwapInterval(Pacing, Next);
+    LINFO("Swap interval: %d", Pacing->SwapInterval);
+}
+
+// Called before the frame samples any input. Retires finished frames,
+// oldest first, and blocks only when MaxFramesInFlight are still queued.
+static void WaitForFrameSlot(frame_pacing *Pacing) {
+    if (!Pacing->HasFences) {
+        return;
+    }
+
+    u32 Outstanding = 0;
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (Pacing->Fences[i]) {
+            ++Outstanding;
+        }
+    }
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        u32 Slot = (Pacing->FrameIndex + i) % MAX_FRAMES_IN_FLIGHT;
+        GLsync Fence = Pacing->Fences[Slot];
+        if (!Fence) {
+            continue;
+        }
+
+        b32 MustWait = (Outstanding >= Pacing->MaxFramesInFlight);
+        GLuint64 Timeout = MustWait ? FRAME_PACING_WAIT_TIMEOUT_NS : 0;
+        GLenum Result = glClientWaitSync(Fence, GL_SYNC_FLUSH_COMMANDS_BIT, Timeout);
+        b32 Signaled = (Result == GL_ALREADY_SIGNALED || Result == GL_CONDITION_SATISFIED);
+        if (!Signaled && !MustWait) {
+            // Frames complete in order, later ones can't be done either
+            break;
+        }
+
+        if (Signaled) {
+            LARGE_INTEGER Now;
+            QueryPerformanceCounter(&Now);
+            f32 LatencyMs = (f32)(1000.0*(f64)(Now.QuadPart - Pacing->InputCounters[Slot])/Pacing->CounterFrequency);
+            Pacing->LatencyMs = LatencyMs;
+            if (Pacing->FilteredLatencyMs == 0.f) {
+                Pacing->FilteredLatencyMs = LatencyMs;
+            }
+            Pacing->FilteredLatencyMs += FRAME_PACING_LATENCY_FILTER*(LatencyMs - Pacing->FilteredLatencyMs);
+        }
+        else {
+            LWARN("Frame fence wait failed: 0x%x", Result);
+        }
+        glDeleteSync(Fence);
+        Pacing->Fences[Slot] = 0;
+        --Outstanding;
+    }
+}
+
+// Re-reads the cursor instead of waiting for the next WM_MOUSEMOVE
+static void LateLatchMouse(HWND Window) {
+    POINT Cursor;
+    if (GetCursorPos(&Cursor) && ScreenToClient(Window, &Cursor)) {
+        GlobalMouseP = vec2((f32)Cursor.x, (f32)Cursor.y);
+    }
+}
+
+// Called after SwapBuffers. InputCounter is when the frame's input was
+// last sampled.
+static void EndFramePacing(frame_pacing *Pacing, i64 InputCounter) {
+    if (!Pacing->HasFences) {
+        return;
+    }
+
+    u32 Slot = Pacing->FrameIndex;
+    if (Pacing->Fences[Slot]) {
+        // WaitForFrameSlot always retires the oldest slot when the ring is full
+        glDeleteSync(Pacing->Fences[Slot]);
+    }
+    Pacing->Fences[Slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    Pacing->InputCounters[Slot] = InputCounter;
+    Pacing->FrameIndex = (Pacing->FrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+}
@@ -10,7 +10,8 @@
 #define WGL_CONTEXT_DEBUG_BIT_ARB           0x00000001
 
 typedef HGLRC WINAPI wgl_create_context_attribs_arb(HDC DC, HGLRC SharedContext, i32 *Attribs);
-typedef void WINAPI wgl_swap_interval_ext(u32 Interval);
+typedef BOOL WINAPI wgl_swap_interval_ext(int Interval);
+typedef const char * WINAPI wgl_get_extensions_string_ext(void);
 
 static opengl *WindowsInitOpenGL(HDC DC) {
     opengl *OpenGL = NULL;
@@ -48,14 +49,6 @@ static opengl *WindowsInitOpenGL(HDC DC) {
                 wglDeleteContext(RC);
                 RC = ModernRC;
 
-                wgl_swap_interval_ext *wglSwapIntervalEXT = (wgl_swap_interval_ext *)wglGetProcAddress("wglSwapIntervalEXT");
-                if (wglSwapIntervalEXT) {
-                    wglSwapIntervalEXT(1);
-                }
-                else {
-                    LINFO("No VSync support.");
-                }
-
                 glCreateShader = (gl_create_shader *)wglGetProcAddress("glCreateShader");
                 glDeleteShader = (gl_delete_shader *)wglGetProcAddress("glDeleteShader");
                 glShaderSource = (gl_shader_source *)wglGetProcAddress("glShaderSource");
@@ -86,8 +79,12 @@ static opengl *WindowsInitOpenGL(HDC DC) {
                 glBindBuffer = (gl_bind_buffer *)wglGetProcAddress("glBindBuffer");
                 glBufferData = (gl_buffer_data *)wglGetProcAddress("glBufferData");
                 glBufferSubData = (gl_buffer_sub_data *)wglGetProcAddress("glBufferSubData");
+                glGetBufferSubData = (gl_get_buffer_sub_data *)wglGetProcAddress("glGetBufferSubData");
 
                 glDrawElementsBaseVertex = (gl_draw_elements_base_vertex *)wglGetProcAddress("glDrawElementsBaseVertex");
+                glDrawElementsInstancedBaseVertexBaseInstance = (gl_draw_elements_instanced_base_vertex_base_instance *)wglGetProcAddress("glDrawElementsInstancedBaseVertexBaseInstance");
+                glDrawArraysInstanced = (gl_draw_arrays_instanced *)wglGetProcAddress("glDrawArraysInstanced");
+                glMultiDrawElementsIndirect = (gl_multi_draw_elements_indirect *)wglGetProcAddress("glMultiDrawElementsIndirect");
 
                 glGetAttribLocation = (gl_get_attrib_location *)wglGetProcAddress("glGetAttribLocation");
                 glBindAttribLocation = (gl_bind_attrib_location *)wglGetProcAddress("glBindAttribLocation");
@@ -95,19 +92,54 @@ static opengl *WindowsInitOpenGL(HDC DC) {
                 glDisableVertexAttribArray = (gl_disable_vertex_attrib_array *)wglGetProcAddress("glDisableVertexAttribArray");
                 glVertexAttribPointer = (gl_vertex_attrib_pointer *)wglGetProcAddress("glVertexAttribPointer");
                 glVertexAttribIPointer = (gl_vertex_attribi_pointer *)wglGetProcAddress("glVertexAttribIPointer");
+                glVertexAttribDivisor = (gl_vertex_attrib_divisor *)wglGetProcAddress("glVertexAttribDivisor");
 
                 glGenFramebuffers = (gl_gen_framebuffers *)wglGetProcAddress("glGenFramebuffers");
+                glDeleteFramebuffers = (gl_delete_framebuffers *)wglGetProcAddress("glDeleteFramebuffers");
                 glBindFramebuffer = (gl_bind_framebuffer *)wglGetProcAddress("glBindFramebuffer");
                 glFramebufferTexture2D = (gl_framebuffer_texture_2d *)wglGetProcAddress("glFramebufferTexture2D");
                 glCheckFramebufferStatus = (gl_check_framebuffer_status *)wglGetProcAddress("glCheckFramebufferStatus");
                 glTexImage2DMultisample = (gl_tex_image_2d_multisample *)wglGetProcAddress("glTexImage2DMultisample");
                 glBlitFramebuffer = (gl_blit_framebuffer *)wglGetProcAddress("glBlitFramebuffer");
+                glInvalidateFramebuffer = (gl_invalidate_framebuffer *)wglGetProcAddress("glInvalidateFramebuffer");
 
                 glGenRenderbuffers = (gl_gen_render_buffers *)wglGetProcAddress("glGenRenderbuffers");
+                glDeleteRenderbuffers = (gl_delete_render_buffers *)wglGetProcAddress("glDeleteRenderbuffers");
+                glRenderbufferStorage = (gl_render_buffer_storage *)wglGetProcAddress("glRenderbufferStorage");
                 glBindRenderbuffer = (gl_bind_renderbuffer *)wglGetProcAddress("glBindRenderbuffer");
                 glRenderbufferStorageMultisample = (gl_render_buffer_storage_multisample *)wglGetProcAddress("glRenderbufferStorageMultisample");
                 glFramebufferRenderbuffer = (gl_framebuffer_renderbuffer *)wglGetProcAddress("glFramebufferRenderbuffer");
 
+                glGetProgramBinary = (gl_get_program_binary *)wglGetProcAddress("glGetProgramBinary");
+                glProgramBinary = (gl_program_binary *)wglGetProcAddress("glProgramBinary");
+                glProgramParameteri = (gl_program_parameteri *)wglGetProcAddress("glProgramParameteri");
+
+                glMaxShaderCompilerThreadsKHR = (gl_max_shader_compiler_threads_khr *)wglGetProcAddress("glMaxShaderCompilerThreadsKHR");
+                if (!glMaxShaderCompilerThreadsKHR) {
+                    glMaxShaderCompilerThreadsKHR = (gl_max_shader_compiler_threads_khr *)wglGetProcAddress("glMaxShaderCompilerThreadsARB");
+                }
+
+                glActiveTexture = (gl_active_texture *)wglGetProcAddress("glActiveTexture");
+                glDrawBuffers = (gl_draw_buffers *)wglGetProcAddress("glDrawBuffers");
+                glBlendFunci = (gl_blend_funci *)wglGetProcAddress("glBlendFunci");
+                glClearBufferfv = (gl_clear_bufferfv *)wglGetProcAddress("glClearBufferfv");
+                glClearBufferuiv = (gl_clear_bufferuiv *)wglGetProcAddress("glClearBufferuiv");
+                glColorMaski = (gl_color_maski *)wglGetProcAddress("glColorMaski");
+
+                glGetStringi = (gl_get_stringi *)wglGetProcAddress("glGetStringi");
+
+                glGenQueries = (gl_gen_queries *)wglGetProcAddress("glGenQueries");
+                glDeleteQueries = (gl_delete_queries *)wglGetProcAddress("glDeleteQueries");
+                glBeginQuery = (gl_begin_query *)wglGetProcAddress("glBeginQuery");
+                glEndQuery = (gl_end_query *)wglGetProcAddress("glEndQuery");
+                glGetQueryObjectuiv = (gl_get_query_objectuiv *)wglGetProcAddress("glGetQueryObjectuiv");
+                glGetQueryObjectui64v = (gl_get_query_objectui64v *)wglGetProcAddress("glGetQueryObjectui64v");
+                glQueryCounter = (gl_query_counter *)wglGetProcAddress("glQueryCounter");
+
+                glFenceSync = (gl_fence_sync *)wglGetProcAddress("glFenceSync");
+                glClientWaitSync = (gl_client_wait_sync *)wglGetProcAddress("glClientWaitSync");
+                glDeleteSync = (gl_delete_sync *)wglGetProcAddress("glDeleteSync");
+
                 glDebugMessageCallback = (gl_debug_message_callback *)wglGetProcAddress("glDebugMessageCallback");
 
                 size_t OpenGLSize = sizeof(opengl);
@@ -0,0 +1,78 @@
+#pragma once
+
+// Win32 services shared by the game and the asset cooker
+
+// for hot reload code, I could expose these functions and pass them to the lib
+// by calling a library function which hooks these definitions
+static void *PlatformAllocate(size_t Size) {
+    void *Result = VirtualAlloc(0, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!Result) {
+        Assert(!"Allocate memory failed");
+    }
+    return Result;
+}
+
+static f64 PlatformGetSeconds() {
+    LARGE_INTEGER Counter;
+    LARGE_INTEGER Frequency;
+    QueryPerformanceCounter(&Counter);
+    QueryPerformanceFrequency(&Frequency);
+    return (f64)Counter.QuadPart/Frequency.QuadPart;
+}
+
+static void PlatformSleep(u32 Milliseconds) {
+    Sleep(Milliseconds);
+}
+
+static u32 PlatformAtomicAdd(volatile u32 *Value, u32 Addend) {
+    return (u32)InterlockedExchangeAdd((LONG volatile *)Value, (LONG)Addend);
+}
+
+static u32 PlatformAtomicExchange(volatile u32 *Value, u32 New) {
+    return (u32)InterlockedExchange((LONG volatile *)Value, (LONG)New);
+}
+
+static u32 PlatformAtomicCompareExchange(volatile u32 *Value, u32 New, u32 Expected) {
+    return (u32)InterlockedCompareExchange((LONG volatile *)Value, (LONG)New, (LONG)Expected);
+}
+
+static entire_file PlatformMapFile(const char *Filename, b32 MissingIsError) {
+    entire_file Result = {};
+    HANDLE File = CreateFileA(Filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (File == INVALID_HANDLE_VALUE) {
+        if (MissingIsError) {
+            LERROR("Failed to open file %s.", Filename);
+        }
+        return Result;
+    }
+
+    LARGE_INTEGER FileSize;
+    if (GetFileSizeEx(File, &FileSize) && FileSize.QuadPart > 0) {
+        HANDLE Mapping = CreateFileMappingA(File, 0, PAGE_READONLY, 0, 0, 0);
+        if (Mapping) {
+            // The view keeps the mapping alive after both handles close
+            Result.Contents = (char *)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+            if (Result.Contents) {
+                Result.Size = (size_t)FileSize.QuadPart;
+            }
+            CloseHandle(Mapping);
+        }
+    }
+    CloseHandle(File);
+
+    if (!Result.Contents) {
+        LERROR("Failed to map file %s.", Filename);
+    }
+    return Result;
+}
+
+static void PlatformUnmapFile(void *Contents) {
+    if (Contents) {
+        UnmapViewOfFile(Contents);
+    }
+}
+
+static b32 PlatformCreateDirectory(char *Path) {
+    b32 Result = (CreateDirectoryA(Path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS);
+    return Result;
+}